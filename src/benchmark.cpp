@@ -21,6 +21,7 @@
 #include <fstream>
 #include <iostream>
 #include <istream>
+#include <sstream>
 #include <vector>
 
 #include "position.h"
@@ -87,19 +88,51 @@ const vector<string> Defaults = {
   "setoption name UCI_Chess960 value false"
 };
 
+// Forced mates in 2 to 5 moves, where every move of the mating side is a check
+const vector<string> Mates = {
+  "kbK5/pp6/1P6/8/8/8/8/R7 w - - 0 1",
+  "6k1/pp4p1/2p5/2bp4/8/P5Pb/1P3rrP/2BRRN1K b - - 0 1",
+  "r1b3kr/ppp1Bp1p/1b6/n2P4/2p3q1/2Q2N2/P4PPP/RN2R1K1 w - - 1 1",
+  "r1bqr3/ppp1B1kp/1b4p1/n2B4/3PQ1P1/2P5/P4P2/RN4K1 w - - 1 1",
+  "r3k2r/ppp2Npp/1b5n/4p2b/2B1P2q/BQP2P2/P5PP/RN5K w kq - 1 1",
+  "r2n1rk1/1ppb2pp/1p1p4/3Ppq1n/2B3P1/2P4P/PP1N1P1K/R2Q1RN1 b - - 0 1",
+  "3q1r1k/2p4p/1p1pBrp1/p2Pp3/2PnP3/5PP1/PP1Q2K1/5R1R w - - 1 1",
+  "6k1/ppp2ppp/8/2n2K1P/2P2P1P/2Bpr3/PP4r1/4RR2 b - - 0 1",
+  "r1b2k1r/ppppq3/5N1p/4P2Q/4PP2/1B6/PP5P/n2K2R1 w - - 1 1",
+  "2q1nk1r/4Rp2/1ppp1P2/6Pp/3p1B2/3P3P/PPP1Q3/6K1 w - - 0 1",
+  "r1b1kb1r/pppp1ppp/5q2/4n3/3KP3/2N3PN/PPP4P/R1BQ1B1R b kq - 0 1",
+  "6r1/p3p1rk/1p1pPp1p/q3n2R/4P3/3BR2P/PPP2QP1/7K w - - 0 1"
+};
+
 } // namespace
 
 /// setup_bench() builds a list of UCI commands to be run by bench. There
-/// are five parameters: TT size in MB, number of search threads that
+/// are six parameters: TT size in MB, number of search threads that
 /// should be used, the limit value spent for each position, a file name
-/// where to look for positions in FEN format and the type of the limit:
-/// depth, perft, nodes and movetime (in millisecs).
+/// where to look for positions in FEN format, the type of the limit:
+/// depth, perft, nodes, movetime (in millisecs), mate and eval, and then
+/// "counters" to report the hardware performance counters and "json" to also
+/// write the per configuration report, see below, as JSON. The eval limit does
+/// not search but runs the NNUE evaluation on every node of the legal move tree
+/// up to the given depth, as a microbenchmark of the network code. The file name
+/// "mates" selects a built-in suite of forced mates.
 ///
 /// bench -> search default positions up to depth 13
 /// bench 64 1 15 -> search default positions up to depth 15 (TT = 64MB)
 /// bench 64 4 5000 current movetime -> search current position with 4 threads for 5 sec
 /// bench 64 1 100000 default nodes -> search default positions for 100K nodes each
 /// bench 16 1 5 default perft -> run a perft 5 on default positions
+/// bench 16 1 2 default eval -> evaluate all nodes up to depth 2 on default positions
+/// bench 16 1 5 mates mate -> look for a mate in 5 on the mate suite
+/// bench 16 1 13 default depth counters -> also report cycles, IPC, misses per node
+///
+/// The TT size and the number of threads can be comma separated lists, in which
+/// case all the positions are searched once for each combination, to measure
+/// the scaling and the efficiency of the TT. A line is reported for each one,
+/// with the time, the speed, the TT hit and collision rates and the hashfull:
+///
+/// bench 256 1,2,4,8,16,32,64,128,256 16 -> time to depth 16 for each thread count
+/// bench 1,4,16,64,256 1,4 1000000 default nodes json -> TT efficiency curves
 
 vector<string> setup_bench(const Position& current, istream& is) {
 
@@ -113,11 +146,19 @@ vector<string> setup_bench(const Position& current, istream& is) {
   string fenFile   = (is >> token) ? token : "default";
   string limitType = (is >> token) ? token : "depth";
 
+  // The report options are passed on at the start of the list
+  while (is >> token)
+      if (token == "counters" || token == "json")
+          list.push_back(token);
+
   go = "go " + limitType + " " + limit;
 
   if (fenFile == "default")
       fens = Defaults;
 
+  else if (fenFile == "mates")
+      fens = Mates;
+
   else if (fenFile == "current")
       fens.push_back(current.fen());
 
@@ -140,17 +181,28 @@ vector<string> setup_bench(const Position& current, istream& is) {
   }
 
   list.emplace_back("ucinewgame");
-  list.emplace_back("setoption name Threads value " + threads);
-  list.emplace_back("setoption name Hash value " + ttSize);
 
-  for (const string& fen : fens)
-      if (fen.find("setoption") != string::npos)
-          list.emplace_back(fen);
-      else
+  string size;
+  istringstream sizes(ttSize);
+  while (getline(sizes, size, ','))
+  {
+      list.emplace_back("setoption name Hash value " + size);
+
+      istringstream counts(threads);
+      while (getline(counts, token, ','))
       {
-          list.emplace_back("position fen " + fen);
-          list.emplace_back(go);
+          list.emplace_back("setoption name Threads value " + token);
+
+          for (const string& fen : fens)
+              if (fen.find("setoption") != string::npos)
+                  list.emplace_back(fen);
+              else
+              {
+                  list.emplace_back("position fen " + fen);
+                  list.emplace_back(go);
+              }
       }
+  }
 
   return list;
 }
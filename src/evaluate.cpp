@@ -172,7 +172,10 @@ namespace Eval {
 		}
 
 		if (useNNUE)
+		{
 			sync_cout << "info string NNUE evaluation using " << eval_file << " enabled" << sync_endl;
+			sync_cout << "info string NNUE " << network_info() << sync_endl;
+		}
 		else
 			sync_cout << "info string classical evaluation enabled" << sync_endl;
 	}
@@ -418,8 +421,7 @@ namespace {
     const Color Them = (Us == WHITE ? BLACK : WHITE);
     const Bitboard OutpostRanks = (Us == WHITE ? Rank4BB | Rank5BB | Rank6BB
                                                : Rank5BB | Rank4BB | Rank3BB);
-    const Square* pl = pos.squares<Pt>(Us);
-
+    Bitboard ourPieces = pos.pieces(Us, Pt);
     Bitboard b, bb;
     Square s;
     Score score = SCORE_ZERO;
@@ -429,8 +431,10 @@ namespace {
     if (Pt == QUEEN)
         attackedBy[Us][QUEEN_DIAGONAL] = 0;
 
-    while ((s = *pl++) != SQ_NONE)
+    while (ourPieces)
     {
+        s = pop_lsb(&ourPieces);
+
         // Find attacked squares, including x-ray attacks for bishops and rooks
         b = Pt == BISHOP ? attacks_bb<BISHOP>(s, pos.pieces() ^ pos.pieces(QUEEN))
           : Pt ==   ROOK ? attacks_bb<  ROOK>(s, pos.pieces() ^ pos.pieces(QUEEN) ^ pos.pieces(Us, ROOK))
@@ -1021,6 +1025,40 @@ namespace {
     return pos.side_to_move() == WHITE ? v : -v; // Side to move point of view
   }
 
+
+  // EvalChoice holds the terms on which evaluate() picks between the classical
+  // and the NNUE evaluation, computed by choose_eval() for evaluate() and for
+  // evaluate_cheap() alike.
+
+  struct EvalChoice {
+    int  r50;
+    bool largePsq, classical, strongClassical;
+  };
+
+  EvalChoice choose_eval(const Position& pos) {
+
+    EvalChoice c;
+
+    // If there is PSQ imbalance use classical eval, with small probability if it is small
+    Value psq = Value(abs(eg_value(pos.psq_score())));
+    c.r50 = 16 + pos.rule50_count();
+    c.largePsq = psq * 16 > (NNUEThreshold1 + pos.non_pawn_material() / 64) * c.r50;
+    c.classical = c.largePsq || (psq > PawnValueMg / 4 && !(pos.this_thread()->nodes & 0xB));
+
+    // Use classical evaluation for really low piece endgames.
+    // The most critical case is a bishop + A/H file pawn vs naked king draw.
+    c.strongClassical = pos.non_pawn_material() < 2 * RookValueMg && pos.count<PAWN>() < 2;
+
+    return c;
+  }
+
+  // Scale and shift NNUE for compatibility with search and classical evaluation
+  Value adjust_nnue(const Position& pos, Value v) {
+
+    int mat = pos.non_pawn_material() + PawnValueMg * pos.count<PAWN>();
+    return v * (679 + mat / 32) / 1024 + Eval::Tempo;
+  }
+
 } // namespace
 
 
@@ -1036,31 +1074,19 @@ Value Eval::evaluate(const Position& pos)
 		return v = Evaluation<>(pos).value() + Eval::Tempo;
 	else
 	{
-		// Scale and shift NNUE for compatibility with search and classical evaluation
-		auto  adjusted_NNUE = [&]() {
-			int mat = pos.non_pawn_material() + PawnValueMg * pos.count<PAWN>();
-			return NNUE::evaluate(pos)* (679 + mat / 32) / 1024 + Tempo;
-		};
-
-		// If there is PSQ imbalance use classical eval, with small probability if it is small
-		Value psq = Value(abs(eg_value(pos.psq_score())));
-		int   r50 = 16 + pos.rule50_count();
-		bool  largePsq = psq * 16 > (NNUEThreshold1 + pos.non_pawn_material() / 64) * r50;
-		bool  classical = largePsq || (psq > PawnValueMg / 4 && !(pos.this_thread()->nodes & 0xB));
+		auto adjusted_NNUE = [&]() { return adjust_nnue(pos, NNUE::evaluate(pos)); };
 
-		// Use classical evaluation for really low piece endgames.
-		// The most critical case is a bishop + A/H file pawn vs naked king draw.
-		bool strongClassical = pos.non_pawn_material() < 2 * RookValueMg && pos.count<PAWN>() < 2;
+		EvalChoice c = choose_eval(pos);
 
-		v = classical || strongClassical ? Evaluation<NO_TRACE>(pos).value() : adjusted_NNUE();
+		v = c.classical || c.strongClassical ? Evaluation<NO_TRACE>(pos).value() : adjusted_NNUE();
 
 		// If the classical eval is small and imbalance large, use NNUE nevertheless.
 		// For the case of opposite colored bishops, switch to NNUE eval with
 		// small probability if the classical eval is less than the threshold.
-		if (largePsq && !strongClassical
-			&& (abs(v) * 16 < NNUEThreshold2 * r50
+		if (c.largePsq && !c.strongClassical
+			&& (abs(v) * 16 < NNUEThreshold2 * c.r50
 				|| (pos.opposite_bishops()
-					&& abs(v) * 16 < (NNUEThreshold1 + pos.non_pawn_material() / 64) * r50
+					&& abs(v) * 16 < (NNUEThreshold1 + pos.non_pawn_material() / 64) * c.r50
 					&& !(pos.this_thread()->nodes & 0xB))))
 			v = adjusted_NNUE();
 	}
@@ -1069,6 +1095,24 @@ Value Eval::evaluate(const Position& pos)
 
 }
 
+
+/// evaluate_cheap() returns the linear readout of the NNUE accumulator, scaled
+/// like evaluate(). It is only meaningful when evaluate() would go straight to
+/// the network, otherwise VALUE_NONE is returned.
+
+Value Eval::evaluate_cheap(const Position& pos)
+{
+	if (!Eval::useNNUE)
+		return VALUE_NONE;
+
+	EvalChoice c = choose_eval(pos);
+
+	if (c.classical || c.strongClassical)
+		return VALUE_NONE;
+
+	return adjust_nnue(pos, NNUE::evaluate_cheap(pos));
+}
+
 /// trace() is like evaluate(), but instead of returning a value, it returns
 /// a string (suitable for outputting to stdout) that contains the detailed
 /// descriptions and values of each evaluation term. Useful for debugging.
@@ -34,6 +34,7 @@ const Value Tempo = Value(20); // Must be visible to search
 std::string trace(const Position& pos);
 
 Value evaluate(const Position& pos);
+Value evaluate_cheap(const Position& pos);
 
 extern bool useNNUE;
 extern std::string eval_file_loaded;
@@ -46,7 +47,12 @@ extern std::string eval_file_loaded;
 namespace NNUE {
 
 	Value evaluate(const Position& pos);
+	Value evaluate_cheap(const Position& pos);
+	void update_accumulators(const Position& pos);
+	void evaluate_children(const Position& pos, const Move* moves, int n);
 	bool load_eval(std::string name, std::istream& stream);
+	std::string network_info();
+	void replicate(bool enabled);
 	void init();
 	void verify();
 
@@ -0,0 +1,305 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2018 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "experience.h"
+#include "movegen.h"
+#include "position.h"
+#include "tt.h"
+#include "uci.h"
+
+namespace {
+
+  // Record is one 16 byte entry of the experience file. The score is from the
+  // point of view of the side to move in the position.
+  struct Record {
+    Key key;
+    uint16_t move;
+    int16_t value;
+    int8_t depth;
+    uint8_t bound;
+    uint8_t padding[2];
+  };
+
+  static_assert(sizeof(Record) == 16, "Record size incorrect");
+
+  std::string file;
+  const Record* records;
+  size_t count;
+  void* mapped;
+  size_t mappedSize;
+  std::vector<Record> loaded; // Used where the file can not be mapped
+  std::vector<Record> pending;
+
+  bool enabled() { return !file.empty() && file != "<empty>"; }
+
+  void unmap() {
+
+#ifndef _WIN32
+    if (mapped)
+        munmap(mapped, mappedSize);
+#endif
+    mapped = nullptr;
+    loaded.clear();
+    records = nullptr;
+    count = 0;
+  }
+
+  // map() maps the experience file in memory. A missing file or a file whose
+  // size is not a multiple of the record size is treated as an empty store.
+  void map() {
+
+    unmap();
+
+    if (!enabled())
+        return;
+
+#ifndef _WIN32
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd == -1)
+        return;
+
+    struct stat st;
+    if (   fstat(fd, &st) == 0
+        && st.st_size > 0
+        && st.st_size % sizeof(Record) == 0)
+    {
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED)
+        {
+            mapped = p;
+            mappedSize = st.st_size;
+            records = static_cast<const Record*>(p);
+            count = st.st_size / sizeof(Record);
+        }
+    }
+    close(fd);
+#else
+    std::ifstream in(file, std::ios::binary | std::ios::ate);
+    if (!in)
+        return;
+
+    std::streamsize size = in.tellg();
+    if (size <= 0 || size % sizeof(Record))
+        return;
+
+    loaded.resize(size / sizeof(Record));
+    in.seekg(0);
+    if (in.read(reinterpret_cast<char*>(loaded.data()), size))
+        records = loaded.data(), count = loaded.size();
+    else
+        loaded.clear();
+#endif
+  }
+
+  const Record* lookup(Key key) {
+
+    const Record* r = std::lower_bound(records, records + count, key,
+                                       [](const Record& a, Key k) { return a.key < k; });
+
+    return r != records + count && r->key == key ? r : nullptr;
+  }
+
+  // seed_position() saves the stored result for the position in the TT, unless
+  // the TT already holds a deeper one.
+  bool seed_position(const Position& pos) {
+
+    const Record* r = lookup(pos.key());
+    bool ttHit;
+
+    if (!r)
+        return false;
+
+    TTEntry* tte = TT.probe(pos.key(), ttHit);
+    if (ttHit && tte->depth() >= r->depth * int(ONE_PLY))
+        return false;
+
+    tte->save(pos.key(), Value(r->value), Bound(r->bound), Depth(r->depth * int(ONE_PLY)),
+              Move(r->move), VALUE_NONE, TT.generation());
+    return true;
+  }
+
+  // record_children() collects the TT entries of the positions after each legal
+  // move that were searched at least to the given depth, so that the moves off
+  // the PV can be cut off as well when the store is used.
+  void record_children(Position& pos, int minDepth) {
+
+    StateInfo st;
+    bool ttHit;
+
+    for (const auto& m : MoveList<LEGAL>(pos))
+    {
+        pos.do_move(m, st);
+        TTEntry* tte = TT.probe(pos.key(), ttHit);
+
+        if (   ttHit
+            && tte->depth() >= minDepth * int(ONE_PLY)
+            && tte->bound() != BOUND_NONE
+            && std::abs(tte->value()) < VALUE_MATE_IN_MAX_PLY)
+            pending.push_back({ pos.key(), uint16_t(tte->move()), int16_t(tte->value()),
+                                int8_t(tte->depth() / ONE_PLY), uint8_t(tte->bound()), {} });
+
+        pos.undo_move(m);
+    }
+  }
+
+} // namespace
+
+
+/// Experience::init() is called when the "Experience File" option changes. The
+/// results collected so far are merged into the previous file first.
+
+void Experience::init(const std::string& fileName) {
+
+  save();
+  file = fileName;
+  map();
+}
+
+
+/// Experience::record() collects the result of the last completed iteration for
+/// the root position and for the positions along the PV, together with the TT
+/// entries of their children, as long as they are close enough to the start of
+/// the game and searched deep enough. Mate scores are not recorded, as they
+/// would need to be adjusted to the distance from the root.
+
+void Experience::record(Position& pos, const Search::RootMove& rm, Depth depth) {
+
+  const int maxPly = Options["Experience Plies"];
+  const int minDepth = Options["Experience Depth"];
+
+  if (!enabled() || std::abs(rm.score) >= VALUE_MATE_IN_MAX_PLY)
+      return;
+
+  StateInfo st[MAX_PLY];
+  Value v = rm.score;
+  int d = depth / ONE_PLY;
+  size_t i = 0;
+
+  while (   i < rm.pv.size()
+         && pos.game_ply() <= maxPly
+         && d >= minDepth)
+  {
+      record_children(pos, minDepth);
+      pending.push_back({ pos.key(), uint16_t(rm.pv[i]), int16_t(v),
+                          int8_t(std::min(d, 127)), uint8_t(BOUND_EXACT), {} });
+      pos.do_move(rm.pv[i], st[i]);
+      v = -v, --d, ++i;
+  }
+
+  while (i > 0)
+      pos.undo_move(rm.pv[--i]);
+}
+
+
+/// Experience::seed() pre-seeds the TT with the stored results for the given
+/// position and the positions after each of its legal moves, then does the
+/// same along the line of stored best moves. Returns the number of positions
+/// seeded.
+
+int Experience::seed(Position& pos) {
+
+  if (!count)
+      return 0;
+
+  StateInfo st[MAX_PLY], st2;
+  std::vector<Move> line;
+  int seeded = 0;
+
+  while (line.size() < MAX_PLY)
+  {
+      seeded += seed_position(pos);
+
+      for (const auto& m : MoveList<LEGAL>(pos))
+      {
+          pos.do_move(m, st2);
+          seeded += seed_position(pos);
+          pos.undo_move(m);
+      }
+
+      const Record* r = lookup(pos.key());
+      Move m = r ? Move(r->move) : MOVE_NONE;
+
+      if (!MoveList<LEGAL>(pos).contains(m))
+          break;
+
+      line.push_back(m);
+      pos.do_move(m, st[line.size() - 1]);
+  }
+
+  while (!line.empty())
+  {
+      pos.undo_move(line.back());
+      line.pop_back();
+  }
+
+  return seeded;
+}
+
+
+/// Experience::save() merges the results collected in this session with the
+/// current content of the file, which may have been updated by another process
+/// in the meantime, keeping the deepest result for each position. The merged
+/// store is written to a temporary file which then replaces the original.
+
+void Experience::save() {
+
+  if (!enabled() || pending.empty())
+      return;
+
+  map();
+
+  std::vector<Record> merged(records, records + count);
+  merged.insert(merged.end(), pending.begin(), pending.end());
+  pending.clear();
+
+  std::stable_sort(merged.begin(), merged.end(), [](const Record& a, const Record& b) {
+      return a.key != b.key ? a.key < b.key : a.depth > b.depth; });
+  merged.erase(std::unique(merged.begin(), merged.end(), [](const Record& a, const Record& b) {
+      return a.key == b.key; }), merged.end());
+
+  unmap();
+
+  std::string tmp = file + ".tmp";
+  std::ofstream out(tmp, std::ios::binary);
+  out.write(reinterpret_cast<const char*>(merged.data()), merged.size() * sizeof(Record));
+  out.close();
+
+#ifdef _WIN32
+  std::remove(file.c_str()); // Windows does not rename over an existing file
+#endif
+
+  if (!out || std::rename(tmp.c_str(), file.c_str()))
+      sync_cout << "info string Could not write experience file " << file << sync_endl;
+
+  map();
+}
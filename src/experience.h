@@ -0,0 +1,47 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2018 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef EXPERIENCE_H_INCLUDED
+#define EXPERIENCE_H_INCLUDED
+
+#include <string>
+
+#include "search.h"
+#include "types.h"
+
+class Position;
+
+/// The Experience namespace keeps a persistent store of deep search results for
+/// positions close to the start of the game. The store is a file of fixed size
+/// records sorted by position key, mapped in memory for lookups. New results
+/// are collected during the session and merged into the file on exit, and the
+/// stored results for the root position and its children pre-seed the TT at
+/// every "go".
+
+namespace Experience {
+
+void init(const std::string& fileName);
+void record(Position& pos, const Search::RootMove& rm, Depth depth);
+int seed(Position& pos);
+void save();
+
+} // namespace Experience
+
+#endif // #ifndef EXPERIENCE_H_INCLUDED
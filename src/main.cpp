@@ -21,6 +21,7 @@
 #include <iostream>
 
 #include "bitboard.h"
+#include "experience.h"
 #include "position.h"
 #include "search.h"
 #include "thread.h"
@@ -50,6 +51,7 @@ int main(int argc, char* argv[]) {
 
   UCI::loop(argc, argv);
 
+  Experience::save();
   Threads.set(0);
   return 0;
 }
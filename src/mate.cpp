@@ -0,0 +1,362 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2018 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "mate.h"
+#include "movegen.h"
+#include "position.h"
+#include "thread.h"
+#include "timeman.h"
+#include "uci.h"
+
+using namespace Search;
+
+namespace {
+
+  // The node table has 2^20 entries of 8 bytes. Each entry packs the upper 48
+  // bits of the position key, the smallest number of moves in which a mate has
+  // been proven (0 if none) and the largest number of moves in which a mate
+  // has been disproven (0 if none). Entries are read and written with single
+  // relaxed atomic operations, so that a torn entry can never be seen.
+  constexpr size_t TableSize = 1 << 20;
+  constexpr uint64_t KeyMask = ~uint64_t(0xFFFF);
+
+  // Nodes the main thread may spend in the solver when the search has neither
+  // a time nor a node limit.
+  constexpr uint64_t MainThreadNodes = 1 << 22;
+
+  std::atomic<uint64_t> Table[TableSize];
+  std::atomic_bool tableUsed;
+
+  void probe(Key key, int& proof, int& disproof) {
+
+    uint64_t e = Table[key & (TableSize - 1)].load(std::memory_order_relaxed);
+    bool hit = (e & KeyMask) == (key & KeyMask);
+    proof    = hit ? (e >> 8) & 0xFF : 0;
+    disproof = hit ?  e       & 0xFF : 0;
+  }
+
+  void store(Key key, int proof, int disproof) {
+
+    int oldProof, oldDisproof;
+    probe(key, oldProof, oldDisproof);
+
+    if (oldProof && (!proof || oldProof < proof))
+        proof = oldProof;
+    disproof = std::max(disproof, oldDisproof);
+
+    Table[key & (TableSize - 1)].store(  (key & KeyMask)
+                                       | uint64_t(proof) << 8
+                                       | uint64_t(disproof), std::memory_order_relaxed);
+  }
+
+
+  // generate_checks() generates the legal moves of the attacker that give check,
+  // reusing the generators of the quiescence search. Underpromotions to rook or
+  // bishop and capturing underpromotions are not generated.
+  ExtMove* generate_checks(const Position& pos, ExtMove* moveList) {
+
+    ExtMove* cur = moveList;
+    ExtMove* end = pos.checkers() ? generate<EVASIONS>(pos, moveList)
+                                  : generate<QUIET_CHECKS>(pos, generate<CAPTURES>(pos, moveList));
+    while (cur != end)
+        if (!pos.legal(*cur) || !pos.gives_check(*cur))
+            *cur = (--end)->move;
+        else
+            ++cur;
+
+    return end;
+  }
+
+
+  // Solver runs the checks-only search for one thread. A call to attack(pos, d)
+  // returns true if the side to move can mate within d moves giving check at
+  // every move, defend(pos, d) returns true if every evasion of the side to
+  // move, which is in check, loses to such a mate.
+  struct Solver {
+
+    explicit Solver(Thread& t);
+
+    bool stopped() const { return (Threads.stop || exhausted) && !extracting; }
+    void check_budget();
+    bool attack(Position& pos, int d);
+    bool defend(Position& pos, int d);
+    void extract_pv(Position& pos, int d, std::vector<Move>& pv);
+
+    Thread& th;
+    bool mainThread, extracting = false, exhausted = false;
+    uint64_t maxNodes = 0;
+    TimePoint maxTime = 0;
+    int calls = 0;
+  };
+
+  // The helpers search until a mate is found or the search is stopped. The
+  // main thread, which only runs the solver without helpers, gets half of the
+  // time or of the nodes of the search and then goes back to the normal search,
+  // which also finds the mates that need a quiet move.
+  Solver::Solver(Thread& t) : th(t), mainThread(&t == Threads.main()) {
+
+    if (!mainThread)
+        return;
+
+    if (Limits.use_time_management())
+        maxTime = Time.optimum() / 2;
+    else if (Limits.movetime)
+        maxTime = Limits.movetime / 2;
+
+    if (Limits.nodes)
+        maxNodes = uint64_t(Limits.nodes) / 2;
+    else if (!maxTime)
+        maxNodes = th.nodes + MainThreadNodes;
+  }
+
+  void Solver::check_budget() {
+
+    static_cast<MainThread&>(th).check_time();
+
+    if (   (maxNodes && th.nodes >= maxNodes)
+        || (maxTime && !(++calls & 1023) && Time.elapsed() >= maxTime))
+        exhausted = true;
+  }
+
+  bool Solver::attack(Position& pos, int d) {
+
+    if (mainThread && !extracting)
+        check_budget();
+
+    if (stopped())
+        return false;
+
+    int proof, disproof;
+    probe(pos.key(), proof, disproof);
+
+    if (proof && proof <= d)
+        return true;
+
+    if (disproof >= d)
+        return false;
+
+    ExtMove moves[MAX_MOVES], *end = generate_checks(pos, moves);
+    StateInfo st;
+
+    // Look for a mate in one, and order the other checks by the number of
+    // replies left to the defender, fewest first.
+    for (ExtMove* m = moves; m != end; ++m)
+    {
+        pos.do_move(*m, st, true);
+        m->value = -int(MoveList<LEGAL>(pos).size());
+        pos.undo_move(*m);
+
+        if (m->value == 0)
+        {
+            store(pos.key(), 1, 0);
+            return true;
+        }
+    }
+
+    if (d > 1)
+    {
+        // Stable insertion sort, std::stable_sort would allocate at every node
+        for (ExtMove* p = moves + 1; p < end; ++p)
+        {
+            ExtMove tmp = *p, *q;
+            for (q = p; q != moves && *(q - 1) < tmp; --q)
+                *q = *(q - 1);
+            *q = tmp;
+        }
+
+        for (ExtMove* m = moves; m != end; ++m)
+        {
+            pos.do_move(*m, st, true);
+            bool mate = defend(pos, d);
+            pos.undo_move(*m);
+
+            if (mate)
+            {
+                store(pos.key(), d, 0);
+                return true;
+            }
+        }
+
+        if (stopped())
+            return false;
+    }
+
+    store(pos.key(), 0, d);
+    return false;
+  }
+
+  bool Solver::defend(Position& pos, int d) {
+
+    MoveList<LEGAL> evasions(pos);
+    StateInfo st;
+
+    if (!evasions.size())
+        return true;
+
+    if (d == 1)
+        return false;
+
+    for (Move m : evasions)
+    {
+        pos.do_move(m, st);
+        bool mate = attack(pos, d - 1);
+        pos.undo_move(m);
+
+        if (!mate)
+            return false;
+    }
+
+    return true;
+  }
+
+
+  // extract_pv() appends a mating line to the pv, the defender choosing the
+  // evasion that delays the mate the longest. The position after the last
+  // move of the pv is the defender to move, with the mate in d proven.
+  void Solver::extract_pv(Position& pos, int d, std::vector<Move>& pv) {
+
+    MoveList<LEGAL> evasions(pos);
+    Move best = MOVE_NONE;
+    int bestD = 0;
+    StateInfo st, st2;
+
+    for (Move m : evasions)
+    {
+        pos.do_move(m, st);
+        int k = 1;
+        while (k < d - 1 && !attack(pos, k))
+            ++k;
+        pos.undo_move(m);
+
+        if (k > bestD)
+            best = m, bestD = k;
+    }
+
+    if (best == MOVE_NONE)
+        return;
+
+    pv.push_back(best);
+    pos.do_move(best, st);
+
+    ExtMove moves[MAX_MOVES], *end = generate_checks(pos, moves);
+    for (ExtMove* m = moves; m != end; ++m)
+    {
+        pos.do_move(*m, st2, true);
+        bool mate = defend(pos, bestD);
+        if (mate)
+        {
+            pv.push_back(*m);
+            extract_pv(pos, bestD, pv);
+        }
+        pos.undo_move(*m);
+
+        if (mate)
+            break;
+    }
+
+    pos.undo_move(best);
+  }
+
+} // namespace
+
+
+/// Mate::clear() empties the node table. Unlike Search::clear(), which go()
+/// calls before every search, it is called on "ucinewgame" only, as the entries
+/// do not depend on the root position.
+
+void Mate::clear() {
+
+  if (tableUsed)
+      for (auto& e : Table)
+          e.store(0, std::memory_order_relaxed);
+
+  tableUsed = false;
+}
+
+
+/// Mate::search() looks for a mate within Limits.mate moves from the root
+/// position of the given thread. The threads share the node table and try the
+/// root moves in a different order each. As every thread deepens one move at
+/// a time over all the root moves, the first mate found is a shortest one. It
+/// then becomes the first root move with its score and PV, and the search is
+/// stopped. Returns false if no mate was found, the search was stopped or the
+/// main thread used up its budget.
+
+bool Mate::search(Thread& th) {
+
+  Solver solver(th);
+  Position& pos = th.rootPos;
+  std::vector<Move> checks;
+  StateInfo st;
+
+  tableUsed = true;
+
+  for (const RootMove& rm : th.rootMoves)
+      if (pos.gives_check(rm.pv[0]))
+          checks.push_back(rm.pv[0]);
+
+  if (checks.empty())
+      return false;
+
+  size_t offset = std::find(Threads.begin(), Threads.end(), &th) - Threads.begin();
+  std::rotate(checks.begin(), checks.begin() + offset % checks.size(), checks.end());
+
+  for (int d = 1; d <= std::min(Limits.mate, 127) && !solver.stopped(); ++d)
+      for (Move m : checks)
+      {
+          pos.do_move(m, st, true);
+          bool mate = solver.defend(pos, d);
+
+          if (mate)
+          {
+              RootMove& rm = *std::find(th.rootMoves.begin(), th.rootMoves.end(), m);
+              rm.pv.resize(1);
+              solver.extracting = true;
+              solver.extract_pv(pos, d, rm.pv);
+              rm.score = mate_in(2 * d - 1);
+              rm.selDepth = int(rm.pv.size());
+          }
+
+          pos.undo_move(m);
+
+          if (mate)
+          {
+              auto it = std::find(th.rootMoves.begin(), th.rootMoves.end(), m);
+              std::rotate(th.rootMoves.begin(), it, it + 1);
+              th.PVIdx = 0;
+              th.completedDepth = th.rootDepth = (2 * d - 1) * ONE_PLY;
+              Threads.stop = true;
+
+              if (solver.mainThread)
+                  sync_cout << UCI::pv(pos, th.completedDepth, -VALUE_INFINITE, VALUE_INFINITE) << sync_endl;
+
+              return true;
+          }
+
+          if (solver.stopped())
+              break;
+      }
+
+  return false;
+}
@@ -0,0 +1,39 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2018 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MATE_H_INCLUDED
+#define MATE_H_INCLUDED
+
+class Thread;
+
+/// The Mate namespace holds a dedicated solver for "go mate N". It runs a
+/// checks-only alpha-beta search, where the attacker is restricted to checking
+/// moves and the defender to evasions, with iterative deepening on the number
+/// of moves and a small lock-free table of proven and disproven positions
+/// shared by all the threads.
+
+namespace Mate {
+
+void clear();
+bool search(Thread& th);
+
+} // namespace Mate
+
+#endif // #ifndef MATE_H_INCLUDED
@@ -36,10 +36,22 @@ typedef bool(*fun3_t)(HANDLE, CONST GROUP_AFFINITY*, PGROUP_AFFINITY);
 }
 #endif
 
+#if defined(__linux__) && !defined(__ANDROID__)
+#include <dirent.h>
+#include <linux/perf_event.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <cstdlib>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <limits>
 #include <sstream>
+#include <thread>
 #include <vector>
 
 #include "misc.h"
@@ -128,23 +140,224 @@ void dbg_print() {
 }
 
 
-/// Used to serialize access to std::cout to avoid multiple threads writing at
-/// the same time.
+namespace {
 
-std::ostream& operator<<(std::ostream& os, SyncCout sc) {
+/// OutputQueue is an intrusive multi-producer single-consumer queue of output
+/// lines, after Dmitry Vyukov. Producers only do an atomic exchange, so they
+/// never wait on each other or on the consumer, the output thread, which
+/// writes the lines to std::cout and sleeps when there is nothing to write.
+
+struct OutputNode {
+  string line;
+  std::atomic<OutputNode*> next;
+};
+
+class OutputQueue {
+
+  std::atomic<OutputNode*> head;
+  OutputNode* tail;
+  OutputNode stub;
+
+  // The mutex and condition variable are used only to park the output thread
+  // and are never destroyed, as the detached thread may outlive main().
+  Mutex& mutex = *new Mutex;
+  ConditionVariable& cv = *new ConditionVariable;
+  std::atomic<bool> sleeping;
+  std::atomic<uint64_t> pushed, popped;
+
+  void push(OutputNode* n) {
+
+    n->next.store(nullptr, std::memory_order_relaxed);
+    OutputNode* prev = head.exchange(n, std::memory_order_acq_rel);
+    prev->next.store(n, std::memory_order_release);
+  }
+
+  // pop() returns the oldest node, or nullptr if the queue is empty or if a
+  // producer is in the middle of a push, in which case we simply retry later.
+  OutputNode* pop() {
+
+    OutputNode* t = tail;
+    OutputNode* next = t->next.load(std::memory_order_acquire);
+
+    if (t == &stub)
+    {
+        if (!next)
+            return nullptr;
+
+        tail = t = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+
+    if (next)
+        return tail = next, t;
+
+    if (t != head.load(std::memory_order_acquire))
+        return nullptr;
+
+    push(&stub);
+    next = t->next.load(std::memory_order_acquire);
+
+    return next ? tail = next, t : nullptr;
+  }
 
-  static Mutex m;
+  void output_loop() {
+
+    while (true)
+    {
+        bool written = false;
+
+        for (OutputNode* n; (n = pop()) != nullptr; written = true)
+        {
+            std::cout << n->line;
+            delete n;
+            ++popped;
+        }
+
+        if (written)
+            std::cout.flush();
+
+        std::unique_lock<Mutex> lk(mutex);
+        sleeping = true;
+        cv.wait(lk, [&]{ return pushed != popped; });
+        sleeping = false;
+    }
+  }
+
+public:
+  OutputQueue() : head(&stub), tail(&stub), sleeping(false), pushed(0), popped(0) {
+
+    stub.next = nullptr;
+    std::thread(&OutputQueue::output_loop, this).detach();
+    std::atexit(sync_flush);
+  }
+
+  void enqueue(string&& line) {
+
+    push(new OutputNode{ std::move(line), {} });
+    ++pushed;
+
+    if (sleeping)
+    {
+        std::lock_guard<Mutex> lk(mutex);
+        cv.notify_one();
+    }
+  }
+
+  void flush() const {
+
+    while (popped != pushed)
+        std::this_thread::yield();
+  }
+};
+
+// Never destroyed, see the comment on OutputQueue::mutex
+OutputQueue& output_queue() {
+
+  static OutputQueue* q = new OutputQueue;
+  return *q;
+}
+
+thread_local std::ostringstream lineBuffer;
+
+} // namespace
+
+
+/// With ALLOC_TRACKING defined, "make allocs=yes", the global operator new
+/// counts the heap allocations made by each thread, so that we can check that
+/// the search does not allocate. heap_allocations() returns the count of the
+/// calling thread, always 0 without ALLOC_TRACKING.
+
+#ifdef ALLOC_TRACKING
+
+namespace { thread_local uint64_t allocations; }
+
+void* operator new(size_t size) {
+
+  ++allocations;
+
+  void* mem = std::malloc(size ? size : 1);
+  if (!mem)
+      std::abort(); // No exceptions, see the Makefile
+  return mem;
+}
+
+void operator delete(void* mem) noexcept { std::free(mem); }
+void operator delete(void* mem, size_t) noexcept { std::free(mem); }
+
+uint64_t heap_allocations() { return allocations; }
+
+#else
+
+uint64_t heap_allocations() { return 0; }
+
+#endif
+
+
+/// available_memory() returns the number of bytes that the process can still
+/// allocate: the available memory reported by /proc/meminfo, further limited by
+/// the memory limit of the cgroup of the process, as set for containers. Only
+/// implemented under Linux, elsewhere 0 is returned, meaning unknown.
+
+size_t available_memory() {
+
+#if defined(__linux__)
+  uint64_t avail = 0, limit = 0, usage = 0;
+  string token;
+
+  ifstream meminfo("/proc/meminfo");
+  while (meminfo >> token)
+      if (token == "MemAvailable:" && meminfo >> avail)
+      {
+          avail *= 1024;
+          break;
+      }
+
+  // A cgroup v2 limit reads "max" when not set, a cgroup v1 one a huge number
+  ifstream max("/sys/fs/cgroup/memory.max"), current("/sys/fs/cgroup/memory.current");
+  ifstream v1Max("/sys/fs/cgroup/memory/memory.limit_in_bytes"),
+           v1Current("/sys/fs/cgroup/memory/memory.usage_in_bytes");
+
+  if (   ((max >> limit) && (current >> usage))
+      || ((v1Max >> limit) && (v1Current >> usage)))
+      if (limit < (uint64_t(1) << 60))
+          avail = std::min(avail ? avail : limit, limit > usage ? limit - usage : 0);
+
+  return size_t(std::min<uint64_t>(avail, std::numeric_limits<size_t>::max()));
+#else
+  return 0;
+#endif
+}
+
+
+/// sync_stream() returns the output buffer of the calling thread
+
+std::ostream& sync_stream() { return lineBuffer; }
+
+
+/// Starting a line with IO_LOCK empties the buffer of the calling thread,
+/// ending it with IO_UNLOCK queues it for the output thread. Whatever the
+/// stream they are applied to, they act on the buffer of the calling thread.
+
+std::ostream& operator<<(std::ostream& os, SyncCout sc) {
 
   if (sc == IO_LOCK)
-      m.lock();
+      lineBuffer.str(string());
 
   if (sc == IO_UNLOCK)
-      m.unlock();
+  {
+      lineBuffer << '\n';
+      output_queue().enqueue(lineBuffer.str());
+  }
 
   return os;
 }
 
 
+/// sync_flush() waits until the output thread has written all the queued lines
+
+void sync_flush() { output_queue().flush(); }
+
+
 
 
 /// prefetch() preloads the given address in L1/L2 cache. This is a non-blocking
@@ -418,6 +631,195 @@ void bindThisThread(size_t idx) {
 
 } // namespace WinProcGroup
 
+
+namespace Numa {
+
+#if defined(__linux__) && !defined(__ANDROID__)
+
+namespace {
+
+/// node_cpus() reads the CPU list of each NUMA node from sysfs. The lists are
+/// in the "0-7,16-23" format.
+
+vector<vector<int>> node_cpus() {
+
+  vector<vector<int>> nodes;
+
+  for (int n = 0; ; ++n)
+  {
+      ifstream file("/sys/devices/system/node/node" + to_string(n) + "/cpulist");
+      if (!file.is_open())
+          break;
+
+      vector<int> cpus;
+      string range;
+
+      while (getline(file, range, ','))
+      {
+          istringstream ss(range);
+          int first, last;
+          char dash;
+
+          if (!(ss >> first))
+              continue;
+
+          if (!(ss >> dash >> last))
+              last = first;
+
+          for (int c = first; c <= last; ++c)
+              cpus.push_back(c);
+      }
+
+      if (!cpus.empty())
+          nodes.push_back(cpus);
+  }
+
+  return nodes;
+}
+
+const vector<vector<int>>& nodes() {
+  static const vector<vector<int>> n = node_cpus();
+  return n;
+}
+
+} // namespace
+
+size_t node_count() { return std::max(size_t(1), nodes().size()); }
+
+void bind_this_thread(size_t node) {
+
+  if (node >= nodes().size())
+      return;
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int c : nodes()[node])
+      CPU_SET(c, &set);
+
+  sched_setaffinity(0, sizeof(cpu_set_t), &set);
+}
+
+#else
+
+size_t node_count() { return 1; }
+
+void bind_this_thread(size_t) {}
+
+#endif
+
+size_t node_of(size_t idx) { return idx % node_count(); }
+
+} // namespace Numa
+
+
+namespace PerfCounters {
+
+Sample& Sample::operator+=(const Sample& s) {
+
+  for (int e = 0; e < EVENT_NB; ++e)
+  {
+      count[e] += s.count[e];
+      valid[e] = valid[e] || s.valid[e];
+  }
+  return *this;
+}
+
+#if defined(__linux__) && !defined(__ANDROID__)
+
+namespace {
+
+constexpr uint64_t cache_miss(uint64_t cache) {
+  return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+const struct { uint32_t type; uint64_t config; } Events[EVENT_NB] = {
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+  { PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_L1D) },
+  { PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_LL) },
+  { PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_DTLB) },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES }
+};
+
+// One counter per event and per thread of the process, as a counter opened
+// for a thread does not count the threads that already exist.
+vector<int> fds[EVENT_NB];
+
+vector<pid_t> process_threads() {
+
+  vector<pid_t> tids;
+  DIR* dir = opendir("/proc/self/task");
+
+  if (dir)
+  {
+      while (dirent* entry = readdir(dir))
+          if (entry->d_name[0] != '.')
+              tids.push_back(pid_t(atoi(entry->d_name)));
+
+      closedir(dir);
+  }
+  return tids;
+}
+
+} // namespace
+
+bool start() {
+
+  bool any = false;
+
+  for (int e = 0; e < EVENT_NB; ++e)
+  {
+      perf_event_attr attr = {};
+      attr.size = sizeof(attr);
+      attr.type = Events[e].type;
+      attr.config = Events[e].config;
+      attr.exclude_kernel = attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+      for (pid_t tid : process_threads())
+      {
+          int fd = int(syscall(__NR_perf_event_open, &attr, tid, -1, -1, 0));
+          if (fd != -1)
+              fds[e].push_back(fd), any = true;
+      }
+  }
+
+  return any;
+}
+
+Sample stop() {
+
+  Sample s;
+
+  for (int e = 0; e < EVENT_NB; ++e)
+  {
+      for (int fd : fds[e])
+      {
+          // Scale the count if the kernel had to multiplex the counters
+          uint64_t v[3]; // Value, time enabled, time running
+          if (read(fd, v, sizeof(v)) == sizeof(v) && v[2])
+          {
+              s.count[e] += double(v[0]) * v[1] / v[2];
+              s.valid[e] = true;
+          }
+          close(fd);
+      }
+      fds[e].clear();
+  }
+
+  return s;
+}
+
+#else
+
+bool start() { return false; }
+
+Sample stop() { return Sample(); }
+
+#endif
+
+} // namespace PerfCounters
+
 #ifdef _WIN32
 #include <direct.h>
 #define GETCWD _getcwd
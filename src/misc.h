@@ -43,6 +43,9 @@ void dbg_hit_on(bool c, bool b);
 void dbg_mean_of(int v);
 void dbg_print();
 
+uint64_t heap_allocations();
+size_t available_memory();
+
 typedef std::chrono::milliseconds::rep TimePoint; // A value in milliseconds
 
 inline TimePoint now() {
@@ -59,11 +62,17 @@ private:
 };
 
 
+/// sync_cout and sync_endl build a line of output in a per-thread buffer, that
+/// is then queued for a dedicated output thread, so that writing threads never
+/// block on std::cout. sync_flush() waits until all queued lines are written.
+
 enum SyncCout { IO_LOCK, IO_UNLOCK };
 std::ostream& operator<<(std::ostream&, SyncCout);
+std::ostream& sync_stream();
+void sync_flush();
 
-#define sync_cout std::cout << IO_LOCK
-#define sync_endl std::endl << IO_UNLOCK
+#define sync_cout sync_stream() << IO_LOCK
+#define sync_endl IO_UNLOCK
 
 
 /// xorshift64star Pseudo-Random Number Generator
@@ -113,6 +122,38 @@ namespace WinProcGroup {
   void bindThisThread(size_t idx);
 }
 
+/// When the NNUE weights are replicated per NUMA node, each search thread is
+/// bound to the CPUs of one node, spreading the threads round-robin over the
+/// nodes. Only implemented under Linux, elsewhere a single node is reported.
+
+namespace Numa {
+  size_t node_count();
+  size_t node_of(size_t idx);
+  void bind_this_thread(size_t node);
+}
+
+/// PerfCounters reads the hardware performance counters of all the threads of
+/// the process between start() and stop(), for the bench command. Only
+/// implemented under Linux with perf_event_open(), events that can not be
+/// opened, as is common in containers and virtual machines, are reported as
+/// not valid.
+
+namespace PerfCounters {
+
+  enum Event {
+    CYCLES, INSTRUCTIONS, L1D_MISSES, LLC_MISSES, DTLB_MISSES, BRANCH_MISSES, EVENT_NB
+  };
+
+  struct Sample {
+    Sample& operator+=(const Sample& s);
+    double count[EVENT_NB] = {};
+    bool valid[EVENT_NB] = {};
+  };
+
+  bool start();
+  Sample stop();
+}
+
 namespace CommandLine {
 	void init(int argc, char* argv[]);
 
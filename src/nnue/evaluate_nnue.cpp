@@ -18,12 +18,17 @@
 
 // Code for calculating NNUE evaluation function
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <set>
+#include <thread>
+#include <vector>
 
 #include "../evaluate.h"
 #include "../position.h"
 #include "../misc.h"
+#include "../thread.h"
 #include "../uci.h"
 
 #include "evaluate_nnue.h"
@@ -60,6 +65,22 @@ namespace Eval::NNUE {
   // Evaluation function file name
   std::string fileName;
 
+  // Copies of the parameters for each NUMA node, see replicate(). When empty,
+  // all the threads share the copies above.
+  struct Replica {
+    LargePagePtr<FeatureTransformer> feature_transformer;
+    AlignedPtr<Network> network;
+  };
+
+  std::vector<Replica> replicas;
+
+  // Linear readout of the transformed features, used as a cheap approximation
+  // of the network output. It is the secant of the network around the start
+  // position, measured once per loaded net.
+  constexpr int kReadoutScale = 16;
+  alignas(kCacheLineSize) std::int32_t readout_weights[FeatureTransformer::kOutputDimensions];
+  std::int32_t readout_bias;
+
   namespace Detail {
 
   // Initialize the evaluation function parameters
@@ -123,24 +144,286 @@ namespace Eval::NNUE {
     return stream && stream.peek() == std::ios::traits_type::eof();
   }
 
+  // Build the linear readout by perturbing, one at a time, each transformed
+  // feature of the start position and measuring the change of the output.
+  void InitReadout() {
+
+    StateInfo st;
+    Position pos;
+    pos.set("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", false, &st, nullptr);
+
+    alignas(kCacheLineSize) TransformedFeatureType
+        transformed_features[FeatureTransformer::kBufferSize];
+    feature_transformer->Transform(pos, transformed_features);
+    alignas(kCacheLineSize) char buffer[Network::kBufferSize];
+    const std::int32_t output0 = network->Propagate(transformed_features, buffer)[0];
+
+    readout_bias = output0 * kReadoutScale;
+    for (IndexType i = 0; i < FeatureTransformer::kOutputDimensions; ++i)
+    {
+      const int x0 = transformed_features[i];
+      const int delta = x0 < 64 ? 64 : -64;
+
+      transformed_features[i] = static_cast<TransformedFeatureType>(x0 + delta);
+      const std::int32_t output = network->Propagate(transformed_features, buffer)[0];
+      transformed_features[i] = static_cast<TransformedFeatureType>(x0);
+
+      readout_weights[i] = (output - output0) * kReadoutScale / delta;
+      readout_bias -= readout_weights[i] * x0;
+    }
+  }
+
+  // Measure on this machine the cost of a refresh, per active feature, and of
+  // an incremental update, per changed feature, and feed their ratio into the
+  // walk-back decision of the feature transformer. The incremental cost is
+  // taken as the marginal cost of walking back one more ply.
+  void CalibrateCostModel() {
+
+    constexpr int Plies = 8, Reps = 500, Rounds = 5;
+    std::string moves[Plies] = { "g1f3", "g8f6", "b1c3", "b8c6", "e2e3", "e7e6", "d2d3", "d7d6" };
+
+    if (Threads.empty())
+      return;
+
+    StateInfo st[Plies + 1];
+    Position pos;
+    pos.set("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", false, &st[0], Threads.main());
+    for (int i = 0; i < Plies; ++i)
+      pos.do_move(UCI::to_move(pos, moves[i]), st[i + 1]);
+
+    alignas(kCacheLineSize) TransformedFeatureType
+        transformed_features[FeatureTransformer::kBufferSize];
+
+    // Time a Transform() where the last computed accumulator is 'plies' plies
+    // back, or none at all for plies < 0. Best of a few rounds, in ns.
+    auto measure = [&](int plies) {
+      double best = 1e9;
+      for (int r = 0; r < Rounds; ++r)
+      {
+        auto start = std::chrono::steady_clock::now();
+        for (int n = 0; n < Reps; ++n)
+        {
+          for (int i = 1; i <= Plies; ++i)
+            for (Color c : { WHITE, BLACK })
+              st[i].accumulator.state[c] = EMPTY;
+          for (Color c : { WHITE, BLACK })
+            st[0].accumulator.state[c] = plies < 0 ? INIT : EMPTY,
+            st[Plies - std::max(plies, 0)].accumulator.state[c] = plies < 0 ? EMPTY : COMPUTED;
+          feature_transformer->Transform(pos, transformed_features);
+        }
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count() / Reps);
+      }
+      return best;
+    };
+
+    feature_transformer->SetCostModel(0, 1); // Never walk back while timing refreshes
+    const double none    = measure(0);
+    const double refresh = measure(-1) - none;
+    feature_transformer->SetCostModel(Plies, 1);
+    const double update  = (measure(Plies) - measure(1)) / (Plies - 1);
+
+    // Quiet moves: one changed feature removed and one added per ply, which
+    // the walk-back loop counts as dirty_num + 1 = 2 units.
+    const int active = popcount(pos.pieces()) - 2;
+    const int updateCost = 16;
+    const int refreshCost = int(std::clamp(updateCost * 2 * (refresh / active) / std::max(update, 1.0), 4.0, 64.0));
+
+    feature_transformer->SetCostModel(refreshCost, updateCost);
+  }
+
+  // Parameters local to the NUMA node of the thread owning the position
+  const Replica* local_replica(const Position& pos) {
+
+    return replicas.empty() || !pos.this_thread() ? nullptr
+          : &replicas[pos.this_thread()->numaNode % replicas.size()];
+  }
+
+  const FeatureTransformer& local_transformer(const Position& pos) {
+
+    const Replica* r = local_replica(pos);
+    return r ? *r->feature_transformer : *feature_transformer;
+  }
+
+  const Network& local_network(const Position& pos) {
+
+    const Replica* r = local_replica(pos);
+    return r ? *r->network : *network;
+  }
+
+  // Update the accumulators of the position, counting the refreshes on the
+  // thread owning it.
+  void transform(const Position& pos, TransformedFeatureType* output) {
+
+    const int refreshes = local_transformer(pos).Transform(pos, output);
+    if (refreshes && pos.this_thread())
+      pos.this_thread()->nnueRefreshes += refreshes;
+  }
+
+  // Compute the accumulators of a position without evaluating it. Called on
+  // the root position before the threads start, so that they all find it
+  // computed instead of refreshing it each.
+  void update_accumulators(const Position& pos) {
+
+    const int refreshes = local_transformer(pos).UpdateAccumulators(pos);
+    if (refreshes && pos.this_thread())
+      pos.this_thread()->nnueRefreshes += refreshes;
+  }
+
+  // Evaluate children of the position together: the accumulators of all the
+  // children are computed in one pass from those of the position, then each
+  // is propagated through the dense layers, whose weights stay in cache from
+  // one child to the next. The results are kept in the batch of the thread
+  // for the ply of the position, where evaluate() finds them.
+  void evaluate_children(const Position& pos, const Move* moves, int n) {
+
+    Thread* th = pos.this_thread();
+    ChildBatch& b = th->childBatches[pos.game_ply() % th->childBatches.size()];
+    const FeatureTransformer& ft = local_transformer(pos);
+    const Network& net = local_network(pos);
+
+    update_accumulators(pos);
+
+    for (int i = 0; i < n; ++i)
+      pos.dirty_piece(moves[i], b.dirtyPiece[i]);
+
+    ft.UpdateChildren(pos, b.dirtyPiece, n, b.accumulator);
+
+    alignas(kCacheLineSize) TransformedFeatureType
+        transformed_features[FeatureTransformer::kBufferSize];
+    alignas(kCacheLineSize) char buffer[Network::kBufferSize];
+
+    for (int i = 0; i < n; ++i)
+    {
+      ft.Transform(b.accumulator[i], ~pos.side_to_move(), transformed_features);
+      b.value[i] = static_cast<Value>(net.Propagate(transformed_features, buffer)[0] / FV_SCALE);
+    }
+
+    b.parentKey = pos.key();
+    b.size = n;
+    th->nnueBatched += n;
+  }
+
+  // If the position is a child evaluated by evaluate_children(), take over its
+  // accumulators and return its value, else return VALUE_NONE.
+  Value from_batch(const Position& pos) {
+
+    Thread* th = pos.this_thread();
+    StateInfo* st = pos.state();
+
+    if (!th || !th->batchEval || !st->previous)
+      return VALUE_NONE;
+
+    const ChildBatch& b = th->childBatches[size_t(pos.game_ply() - 1) % th->childBatches.size()];
+    const DirtyPiece& dp = st->dirtyPiece;
+
+    if (b.parentKey != st->previous->key)
+      return VALUE_NONE;
+
+    for (int i = 0; i < b.size; ++i)
+      if (   b.dirtyPiece[i].dirty_num == dp.dirty_num
+          && std::equal(dp.piece, dp.piece + dp.dirty_num, b.dirtyPiece[i].piece)
+          && std::equal(dp.from, dp.from + dp.dirty_num, b.dirtyPiece[i].from)
+          && std::equal(dp.to, dp.to + dp.dirty_num, b.dirtyPiece[i].to))
+      {
+        for (Color c : { WHITE, BLACK })
+          if (st->accumulator.state[c] != COMPUTED)
+          {
+            std::memcpy(st->accumulator.accumulation[c], b.accumulator[i].accumulation[c],
+                        sizeof(st->accumulator.accumulation[c]));
+            st->accumulator.state[c] = COMPUTED;
+          }
+
+        ++th->nnueBatchHits;
+        return b.value[i];
+      }
+
+    return VALUE_NONE;
+  }
+
+  // Cheap evaluation: accumulator update plus the linear readout, without
+  // propagating through the hidden layers.
+  Value evaluate_cheap(const Position& pos) {
+
+    from_batch(pos); // Only to take over the accumulators
+
+    alignas(kCacheLineSize) TransformedFeatureType
+        transformed_features[FeatureTransformer::kBufferSize];
+    transform(pos, transformed_features);
+
+    std::int32_t sum = readout_bias;
+    for (IndexType i = 0; i < FeatureTransformer::kOutputDimensions; ++i)
+      sum += readout_weights[i] * transformed_features[i];
+
+    return static_cast<Value>(sum / kReadoutScale / FV_SCALE);
+  }
+
   // Evaluation function. Perform differential calculation.
   Value evaluate(const Position& pos) {
 
+    const Value v = from_batch(pos);
+    if (v != VALUE_NONE)
+      return v;
+
     alignas(kCacheLineSize) TransformedFeatureType
         transformed_features[FeatureTransformer::kBufferSize];
-    feature_transformer->Transform(pos, transformed_features);
+    transform(pos, transformed_features);
     alignas(kCacheLineSize) char buffer[Network::kBufferSize];
-    const auto output = network->Propagate(transformed_features, buffer);
+    const auto output = local_network(pos).Propagate(transformed_features, buffer);
 
     return static_cast<Value>(output[0] / FV_SCALE);
   }
 
+  // Copy the parameters once per NUMA node. Each copy is allocated and filled
+  // by a thread bound to its node, so that the first-touch policy of the OS
+  // places its pages there.
+  void replicate(bool enabled) {
+
+    replicas.clear();
+
+    if (!enabled || !feature_transformer || Numa::node_count() < 2)
+      return;
+
+    replicas.resize(Numa::node_count());
+
+    for (size_t node = 0; node < replicas.size(); ++node)
+      std::thread([&]() {
+        Numa::bind_this_thread(node);
+        Replica& r = replicas[node];
+        Detail::Initialize(r.feature_transformer);
+        Detail::Initialize(r.network);
+        std::memcpy(r.feature_transformer.get(), feature_transformer.get(), sizeof(FeatureTransformer));
+        std::memcpy(r.network.get(), network.get(), sizeof(Network));
+      }).join();
+  }
+
+  // Describe the work left in the dense layers after load-time elimination,
+  // and the memory used by the parameters on each NUMA node.
+  std::string network_info() {
+
+    constexpr std::size_t MiB = 1024 * 1024;
+    const std::size_t size = (sizeof(FeatureTransformer) + sizeof(Network) + MiB / 2) / MiB;
+
+    return "dense layers use " + std::to_string(network->GetMacs()) + " of "
+          + std::to_string(Network::kMaxMacs) + " multiply-adds, weights use "
+          + std::to_string(size) + " MiB on each of "
+          + std::to_string(std::max(replicas.size(), std::size_t(1))) + " NUMA node(s), "
+          + "refresh/update cost model " + std::to_string(feature_transformer->RefreshCost())
+          + "/" + std::to_string(feature_transformer->UpdateCost());
+  }
+
   // Load eval, from a file stream or a memory stream
   bool load_eval(std::string name, std::istream& stream) {
 
     Initialize();
     fileName = name;
-    return ReadParameters(stream);
+    if (!ReadParameters(stream))
+      return false;
+
+    InitReadout();
+    CalibrateCostModel();
+    replicate(Options["NUMA Replication"]);
+    return true;
   }
 
 } // namespace Eval::NNUE
@@ -28,12 +28,47 @@ namespace Eval::NNUE::Features {
     return Square(int(s) ^ (bool(perspective) * 63));
   }
 
+  // In-memory position of each king square block and of each piece-square row
+  // inside a block. King squares which are more likely to be occupied come
+  // first, and rows that can never be active (PS_NONE, pawns on the first and
+  // last ranks) are moved to the end of their block, so that the live rows of
+  // the common king squares are packed together.
+  IndexType KingBlock[SQUARE_NB];
+  IndexType PieceSquareRow[PS_END];
+
+  template <Side AssociatedKing>
+  void HalfKP<AssociatedKing>::InitRowOrder() {
+
+    // Castled kings first: g, h, f, e, c, b, d and a-file, nearest ranks first
+    constexpr IndexType KingFileOrder[FILE_NB] = { 7, 5, 4, 6, 3, 2, 0, 1 };
+
+    for (Square s = SQ_A1; s <= SQ_H8; ++s)
+      KingBlock[s] = rank_of(s) * FILE_NB + KingFileOrder[file_of(s)];
+
+    auto live = [](IndexType ps) {
+      Rank r = rank_of(Square((ps - 1) % SQUARE_NB));
+      return ps != PS_NONE && (ps >= PS_W_KNIGHT || (r != RANK_1 && r != RANK_8));
+    };
+
+    IndexType next = 0;
+    for (bool l : { true, false })
+      for (IndexType ps = 0; ps < PS_END; ++ps)
+        if (live(ps) == l)
+          PieceSquareRow[ps] = next++;
+  }
+
+  template <Side AssociatedKing>
+  IndexType HalfKP<AssociatedKing>::RowIndex(IndexType index) {
+
+    return PieceSquareRow[index % PS_END] + PS_END * KingBlock[index / PS_END];
+  }
+
   // Find the index of the feature quantity from the king position and PieceSquare
   template <Side AssociatedKing>
   inline IndexType HalfKP<AssociatedKing>::MakeIndex(
       Color perspective, Square s, Piece pc, Square ksq) {
 
-    return IndexType(orient(perspective, s) + kpp_board_index[pc][perspective] + PS_END * ksq);
+    return PieceSquareRow[orient(perspective, s) + kpp_board_index[pc][perspective]] + PS_END * KingBlock[ksq];
   }
 
   // Get a list of indices for active features
@@ -53,6 +53,12 @@ namespace Eval::NNUE::Features {
     static void AppendChangedIndices(const Position& pos, const DirtyPiece& dp, Color perspective,
                                      IndexList* removed, IndexList* added);
 
+    // Set up the in-memory row order of the features, see RowIndex()
+    static void InitRowOrder();
+
+    // Weight row of a feature given by its index in the evaluation file
+    static IndexType RowIndex(IndexType index);
+
    private:
     // Index of a feature for a given king position and another piece on some square
     static IndexType MakeIndex(Color perspective, Square s, Piece pc, Square sq_k);
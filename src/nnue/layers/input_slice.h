@@ -41,6 +41,9 @@ class InputSlice {
   // Size of forward propagation buffer used from the input layer to this layer
   static constexpr std::size_t kBufferSize = 0;
 
+  // Number of multiply-adds of a forward propagation up to this layer
+  static constexpr std::size_t kMaxMacs = 0;
+
   // Hash value embedded in the evaluation file
   static constexpr std::uint32_t GetHashValue() {
     std::uint32_t hash_value = 0xEC42E90Du;
@@ -53,6 +56,15 @@ class InputSlice {
     return true;
   }
 
+  // The transformed features are computed tile by tile by the feature
+  // transformer, so there is nothing to eliminate here.
+  template <typename WeightType, typename BiasType>
+  void EliminateConstantOutputs(WeightType*, BiasType*, IndexType, IndexType) {}
+
+  std::size_t GetMacs() const {
+    return 0;
+  }
+
   // Forward propagation
   const OutputType* Propagate(
       const TransformedFeatureType* transformed_features,
@@ -35,6 +35,18 @@ namespace Eval::NNUE {
     AccumulatorState state[2];
   };
 
+  // Children of a node evaluated together by evaluate_children(), each given
+  // by the pieces changed by its move
+  struct ChildBatch {
+    static constexpr int kMaxSize = 8;
+
+    Accumulator accumulator[kMaxSize];
+    DirtyPiece dirtyPiece[kMaxSize];
+    Value value[kMaxSize];
+    Key parentKey;
+    int size;
+  };
+
 }  // namespace Eval::NNUE
 
 #endif // NNUE_ACCUMULATOR_H_INCLUDED
@@ -78,20 +78,7 @@ namespace Eval::NNUE {
   // Size of cache line (in bytes)
   constexpr std::size_t kCacheLineSize = 64;
 
-  // SIMD width (in bytes)
-  #if defined(USE_AVX2)
-  constexpr std::size_t kSimdWidth = 32;
-
-  #elif defined(USE_SSE2)
-  constexpr std::size_t kSimdWidth = 16;
-
-  #elif defined(USE_MMX)
-  constexpr std::size_t kSimdWidth = 8;
-
-  #elif defined(USE_NEON)
-  constexpr std::size_t kSimdWidth = 16;
-  #endif
-
+  // Largest SIMD width (in bytes), see nnue_simd.h
   constexpr std::size_t kMaxSimdWidth = 32;
 
   // unique number for each piece type on each square
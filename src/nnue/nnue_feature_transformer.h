@@ -23,62 +23,13 @@
 
 #include "nnue_common.h"
 #include "nnue_architecture.h"
+#include "nnue_simd.h"
 #include "features/index_list.h"
 
 #include <cstring> // std::memset()
 
 namespace Eval::NNUE {
 
-  // If vector instructions are enabled, we update and refresh the
-  // accumulator tile by tile such that each tile fits in the CPU's
-  // vector registers.
-  #define VECTOR
-
-  #ifdef USE_AVX512
-  typedef __m512i vec_t;
-  #define vec_load(a) _mm512_loadA_si512(a)
-  #define vec_store(a,b) _mm512_storeA_si512(a,b)
-  #define vec_add_16(a,b) _mm512_add_epi16(a,b)
-  #define vec_sub_16(a,b) _mm512_sub_epi16(a,b)
-  static constexpr IndexType kNumRegs = 8; // only 8 are needed
-
-  #elif USE_AVX2
-  typedef __m256i vec_t;
-  #define vec_load(a) _mm256_loadA_si256(a)
-  #define vec_store(a,b) _mm256_storeA_si256(a,b)
-  #define vec_add_16(a,b) _mm256_add_epi16(a,b)
-  #define vec_sub_16(a,b) _mm256_sub_epi16(a,b)
-  static constexpr IndexType kNumRegs = 16;
-
-  #elif USE_SSE2
-  typedef __m128i vec_t;
-  #define vec_load(a) (*(a))
-  #define vec_store(a,b) *(a)=(b)
-  #define vec_add_16(a,b) _mm_add_epi16(a,b)
-  #define vec_sub_16(a,b) _mm_sub_epi16(a,b)
-  static constexpr IndexType kNumRegs = Is64Bit ? 16 : 8;
-
-  #elif USE_MMX
-  typedef __m64 vec_t;
-  #define vec_load(a) (*(a))
-  #define vec_store(a,b) *(a)=(b)
-  #define vec_add_16(a,b) _mm_add_pi16(a,b)
-  #define vec_sub_16(a,b) _mm_sub_pi16(a,b)
-  static constexpr IndexType kNumRegs = 8;
-
-  #elif USE_NEON
-  typedef int16x8_t vec_t;
-  #define vec_load(a) (*(a))
-  #define vec_store(a,b) *(a)=(b)
-  #define vec_add_16(a,b) vaddq_s16(a,b)
-  #define vec_sub_16(a,b) vsubq_s16(a,b)
-  static constexpr IndexType kNumRegs = 16;
-
-  #else
-  #undef VECTOR
-
-  #endif
-
   // Input feature converter
   class FeatureTransformer {
 
@@ -86,10 +37,14 @@ namespace Eval::NNUE {
     // Number of output dimensions for one side
     static constexpr IndexType kHalfDimensions = kTransformedFeatureDimensions;
 
-    #ifdef VECTOR
-    static constexpr IndexType kTileHeight = kNumRegs * sizeof(vec_t) / 2;
+    // The accumulators are updated and refreshed tile by tile, such that each
+    // tile fits in the vector registers
+    using Vec = Simd::Vec;
+    using vec_t = Vec::vec_t;
+    static constexpr IndexType kNumRegs = Vec::kNumRegs;
+    static constexpr IndexType kLanes = Vec::kBytes / 2;
+    static constexpr IndexType kTileHeight = kNumRegs * kLanes;
     static_assert(kHalfDimensions % kTileHeight == 0, "kTileHeight must divide kHalfDimensions");
-    #endif
 
    public:
     // Output type
@@ -112,125 +67,217 @@ namespace Eval::NNUE {
     // Read network parameters
     bool ReadParameters(std::istream& stream) {
 
+      SetCostModel(1, 1);
       for (std::size_t i = 0; i < kHalfDimensions; ++i)
         biases_[i] = read_little_endian<BiasType>(stream);
-      for (std::size_t i = 0; i < kHalfDimensions * kInputDimensions; ++i)
-        weights_[i] = read_little_endian<WeightType>(stream);
+      // The rows are rearranged in memory, see HalfKP::RowIndex()
+      Features::HalfKP<Features::Side::kFriend>::InitRowOrder();
+      for (IndexType i = 0; i < kInputDimensions; ++i)
+      {
+        WeightType* row = &weights_[kHalfDimensions *
+            Features::HalfKP<Features::Side::kFriend>::RowIndex(i)];
+        for (std::size_t j = 0; j < kHalfDimensions; ++j)
+          row[j] = read_little_endian<WeightType>(stream);
+      }
       return !stream.fail();
     }
 
-    // Convert input features
-    void Transform(const Position& pos, OutputType* output) const {
+    // Relative costs of refreshing one active feature and of updating one
+    // changed feature, used to decide between refresh and incremental update.
+    void SetCostModel(int refreshCost, int updateCost) {
+      refresh_cost_ = refreshCost;
+      update_cost_ = updateCost;
+    }
+
+    int RefreshCost() const { return refresh_cost_; }
+    int UpdateCost() const { return update_cost_; }
+
+    // Compute the accumulators of the position, incrementally if possible.
+    // Returns the number of accumulators refreshed.
+    int UpdateAccumulators(const Position& pos) const {
 
-      UpdateAccumulator(pos, WHITE);
-      UpdateAccumulator(pos, BLACK);
+      if (UpdateAccumulatorFused(pos))
+        return 0;
 
-      const auto& accumulation = pos.state()->accumulator.accumulation;
+      return UpdateAccumulator(pos, WHITE) + UpdateAccumulator(pos, BLACK);
+    }
 
-  #if defined(USE_AVX2)
-      constexpr IndexType kNumChunks = kHalfDimensions / kSimdWidth;
-      constexpr int kControl = 0b11011000;
-      const __m256i kZero = _mm256_setzero_si256();
+    // Convert input features. Returns the number of accumulators refreshed.
+    int Transform(const Position& pos, OutputType* output) const {
 
-  #elif defined(USE_SSE2)
-      constexpr IndexType kNumChunks = kHalfDimensions / kSimdWidth;
+      const int refreshes = UpdateAccumulators(pos);
+      Transform(pos.state()->accumulator, pos.side_to_move(), output);
+      return refreshes;
+    }
 
-  #ifdef USE_SSE41
-      const __m128i kZero = _mm_setzero_si128();
-  #else
-      const __m128i k0x80s = _mm_set1_epi8(-128);
-  #endif
+    // Convert computed accumulators, given the side to move
+    void Transform(const Accumulator& accumulator, Color stm, OutputType* output) const {
 
-  #elif defined(USE_MMX)
-      constexpr IndexType kNumChunks = kHalfDimensions / kSimdWidth;
-      const __m64 k0x80s = _mm_set1_pi8(-128);
+      const auto& accumulation = accumulator.accumulation;
 
-  #elif defined(USE_NEON)
-      constexpr IndexType kNumChunks = kHalfDimensions / (kSimdWidth / 2);
-      const int8x8_t kZero = {0};
-  #endif
+      // Each chunk packs two vectors of the accumulator into one of output
+      constexpr IndexType kNumChunks = kHalfDimensions / Vec::kBytes;
 
-      const Color perspectives[2] = {pos.side_to_move(), ~pos.side_to_move()};
+      const Color perspectives[2] = {stm, ~stm};
       for (IndexType p = 0; p < 2; ++p) {
         const IndexType offset = kHalfDimensions * p;
+        const auto sum = accumulation[perspectives[p]][0];
+        for (IndexType j = 0; j < kNumChunks; ++j)
+          Vec::store(&output[offset + j * Vec::kBytes], Vec::packs_16(
+              Vec::load(&sum[(j * 2 + 0) * kLanes]), Vec::load(&sum[(j * 2 + 1) * kLanes])));
+      }
+      Vec::cleanup();
+    }
+
+    // Compute the accumulators of children of the position, each given by
+    // the pieces changed by its move, from the computed accumulators of the
+    // position. Every tile of the parent is loaded once for all the children.
+    // King moves, which need a refresh, are not supported.
+    void UpdateChildren(const Position& pos, const DirtyPiece* dps, int n,
+                        Accumulator* children) const {
+
+      vec_t parent[kNumRegs], acc[kNumRegs];
 
-  #if defined(USE_AVX2)
-        auto out = reinterpret_cast<__m256i*>(&output[offset]);
-        for (IndexType j = 0; j < kNumChunks; ++j) {
-          __m256i sum0 = _mm256_loadA_si256(
-              &reinterpret_cast<const __m256i*>(accumulation[perspectives[p]][0])[j * 2 + 0]);
-          __m256i sum1 = _mm256_loadA_si256(
-            &reinterpret_cast<const __m256i*>(accumulation[perspectives[p]][0])[j * 2 + 1]);
-          _mm256_storeA_si256(&out[j], _mm256_permute4x64_epi64(_mm256_max_epi8(
-              _mm256_packs_epi16(sum0, sum1), kZero), kControl));
+      assert(n <= ChildBatch::kMaxSize);
+
+      Features::IndexList removed[2][ChildBatch::kMaxSize], added[2][ChildBatch::kMaxSize];
+      for (int i = 0; i < n; ++i)
+        for (Color c : { WHITE, BLACK })
+        {
+          assert(type_of(dps[i].piece[0]) != KING);
+          Features::HalfKP<Features::Side::kFriend>::AppendChangedIndices(pos,
+              dps[i], c, &removed[c][i], &added[c][i]);
+          children[i].state[c] = COMPUTED;
         }
 
-  #elif defined(USE_SSE2)
-        auto out = reinterpret_cast<__m128i*>(&output[offset]);
-        for (IndexType j = 0; j < kNumChunks; ++j) {
-          __m128i sum0 = _mm_load_si128(&reinterpret_cast<const __m128i*>(
-              accumulation[perspectives[p]][0])[j * 2 + 0]);
-          __m128i sum1 = _mm_load_si128(&reinterpret_cast<const __m128i*>(
-              accumulation[perspectives[p]][0])[j * 2 + 1]);
-      const __m128i packedbytes = _mm_packs_epi16(sum0, sum1);
+      for (IndexType j = 0; j < kHalfDimensions / kTileHeight; ++j)
+        for (Color c : { WHITE, BLACK })
+        {
+          auto accTile = &pos.state()->accumulator.accumulation[c][0][j * kTileHeight];
+          for (IndexType k = 0; k < kNumRegs; ++k)
+            parent[k] = Vec::load(&accTile[k * kLanes]);
 
-          _mm_store_si128(&out[j],
+          for (int i = 0; i < n; ++i)
+          {
+            for (IndexType k = 0; k < kNumRegs; ++k)
+              acc[k] = parent[k];
 
-  #ifdef USE_SSE41
-            _mm_max_epi8(packedbytes, kZero)
-  #else
-            _mm_subs_epi8(_mm_adds_epi8(packedbytes, k0x80s), k0x80s)
-  #endif
+            for (const auto index : removed[c][i])
+            {
+              const IndexType offset = kHalfDimensions * index + j * kTileHeight;
+              for (IndexType k = 0; k < kNumRegs; ++k)
+                acc[k] = Vec::sub_16(acc[k], Vec::load(&weights_[offset + k * kLanes]));
+            }
 
-          );
-        }
+            for (const auto index : added[c][i])
+            {
+              const IndexType offset = kHalfDimensions * index + j * kTileHeight;
+              for (IndexType k = 0; k < kNumRegs; ++k)
+                acc[k] = Vec::add_16(acc[k], Vec::load(&weights_[offset + k * kLanes]));
+            }
 
-  #elif defined(USE_MMX)
-        auto out = reinterpret_cast<__m64*>(&output[offset]);
-        for (IndexType j = 0; j < kNumChunks; ++j) {
-          __m64 sum0 = *(&reinterpret_cast<const __m64*>(
-              accumulation[perspectives[p]][0])[j * 2 + 0]);
-          __m64 sum1 = *(&reinterpret_cast<const __m64*>(
-              accumulation[perspectives[p]][0])[j * 2 + 1]);
-          const __m64 packedbytes = _mm_packs_pi16(sum0, sum1);
-          out[j] = _mm_subs_pi8(_mm_adds_pi8(packedbytes, k0x80s), k0x80s);
+            accTile = &children[i].accumulation[c][0][j * kTileHeight];
+            for (IndexType k = 0; k < kNumRegs; ++k)
+              Vec::store(&accTile[k * kLanes], acc[k]);
+          }
         }
 
-  #elif defined(USE_NEON)
-        const auto out = reinterpret_cast<int8x8_t*>(&output[offset]);
-        for (IndexType j = 0; j < kNumChunks; ++j) {
-          int16x8_t sum = reinterpret_cast<const int16x8_t*>(
-              accumulation[perspectives[p]][0])[j];
-          out[j] = vmax_s8(vqmovn_s16(sum), kZero);
-        }
+      Vec::cleanup();
+    }
 
-  #else
-        for (IndexType j = 0; j < kHalfDimensions; ++j) {
-          BiasType sum = accumulation[static_cast<int>(perspectives[p])][0][j];
-          output[offset + j] = static_cast<OutputType>(
-              std::max<int>(0, std::min<int>(127, sum)));
-        }
-  #endif
+   private:
+    // Update both perspectives incrementally in a single pass over the
+    // StateInfo chain and the accumulator tiles. This is only possible when
+    // both accumulators can be reached from the same computed ancestor without
+    // a king move in between; otherwise return false and let the caller fall
+    // back to the per-perspective UpdateAccumulator(), which handles refreshes.
+    bool UpdateAccumulatorFused(const Position& pos) const {
+
+      vec_t acc[kNumRegs];
 
+      StateInfo *st = pos.state(), *next = nullptr;
+      int gain = refresh_cost_ * (popcount(pos.pieces()) - 2);
+      while (   st->accumulator.state[WHITE] == EMPTY
+             && st->accumulator.state[BLACK] == EMPTY)
+      {
+        auto& dp = st->dirtyPiece;
+        if (   type_of(dp.piece[0]) == KING
+            || (gain -= update_cost_ * (dp.dirty_num + 1)) < 0)
+          return false;
+        next = st;
+        st = st->previous;
       }
-  #if defined(USE_MMX)
-      _mm_empty();
-  #endif
+
+      if (   st->accumulator.state[WHITE] != COMPUTED
+          || st->accumulator.state[BLACK] != COMPUTED)
+        return false;
+
+      if (next == nullptr)
+        return true;
+
+      // Gather the changed features of both perspectives with one walk over
+      // the dirty pieces, indexed by [perspective][step].
+      Features::IndexList removed[2][2], added[2][2];
+      for (Color c : { WHITE, BLACK })
+        Features::HalfKP<Features::Side::kFriend>::AppendChangedIndices(pos,
+            next->dirtyPiece, c, &removed[c][0], &added[c][0]);
+      for (StateInfo *st2 = pos.state(); st2 != next; st2 = st2->previous)
+        for (Color c : { WHITE, BLACK })
+          Features::HalfKP<Features::Side::kFriend>::AppendChangedIndices(pos,
+              st2->dirtyPiece, c, &removed[c][1], &added[c][1]);
+
+      for (Color c : { WHITE, BLACK })
+      {
+        next->accumulator.state[c] = COMPUTED;
+        pos.state()->accumulator.state[c] = COMPUTED;
+      }
+
+      StateInfo *info[3] =
+        { next, next == pos.state() ? nullptr : pos.state(), nullptr };
+      for (IndexType j = 0; j < kHalfDimensions / kTileHeight; ++j)
+        for (Color c : { WHITE, BLACK })
+        {
+          auto accTile = &st->accumulator.accumulation[c][0][j * kTileHeight];
+          for (IndexType k = 0; k < kNumRegs; ++k)
+            acc[k] = Vec::load(&accTile[k * kLanes]);
+
+          for (IndexType i = 0; info[i]; ++i)
+          {
+            for (const auto index : removed[c][i])
+            {
+              const IndexType offset = kHalfDimensions * index + j * kTileHeight;
+              for (IndexType k = 0; k < kNumRegs; ++k)
+                acc[k] = Vec::sub_16(acc[k], Vec::load(&weights_[offset + k * kLanes]));
+            }
+
+            for (const auto index : added[c][i])
+            {
+              const IndexType offset = kHalfDimensions * index + j * kTileHeight;
+              for (IndexType k = 0; k < kNumRegs; ++k)
+                acc[k] = Vec::add_16(acc[k], Vec::load(&weights_[offset + k * kLanes]));
+            }
+
+            accTile = &info[i]->accumulator.accumulation[c][0][j * kTileHeight];
+            for (IndexType k = 0; k < kNumRegs; ++k)
+              Vec::store(&accTile[k * kLanes], acc[k]);
+          }
+        }
+
+      Vec::cleanup();
+      return true;
     }
 
-   private:
-    void UpdateAccumulator(const Position& pos, const Color c) const {
+    // Returns true if the accumulator has been refreshed
+    bool UpdateAccumulator(const Position& pos, const Color c) const {
 
-  #ifdef VECTOR
       // Gcc-10.2 unnecessarily spills AVX2 registers if this array
-      // is defined in the VECTOR code below, once in each branch
+      // is defined in the code below, once in each branch
       vec_t acc[kNumRegs];
-  #endif
 
       // Look for a usable accumulator of an earlier position. We keep track
-      // of the estimated gain in terms of features to be added/subtracted.
+      // of the estimated gain in terms of the cost model, see SetCostModel().
       StateInfo *st = pos.state(), *next = nullptr;
-      int gain = popcount(pos.pieces()) - 2;
+      int gain = refresh_cost_ * (popcount(pos.pieces()) - 2);
       while (st->accumulator.state[c] == EMPTY)
       {
         auto& dp = st->dirtyPiece;
@@ -240,16 +287,18 @@ namespace Eval::NNUE {
               Features::CompileTimeList<Features::TriggerEvent, Features::TriggerEvent::kFriendKingMoved>>,
               "Current code assumes that only kFriendlyKingMoved refresh trigger is being used.");
         if (   dp.piece[0] == make_piece(c, KING)
-            || (gain -= dp.dirty_num + 1) < 0)
+            || (gain -= update_cost_ * (dp.dirty_num + 1)) < 0)
           break;
         next = st;
         st = st->previous;
       }
 
-      if (st->accumulator.state[c] == COMPUTED)
+      const bool refresh = st->accumulator.state[c] != COMPUTED;
+
+      if (!refresh)
       {
         if (next == nullptr)
-          return;
+          return false;
 
         // Update incrementally in two steps. First, we update the "next"
         // accumulator. Then, we update the current accumulator (pos.state()).
@@ -272,14 +321,12 @@ namespace Eval::NNUE {
         // Now update the accumulators listed in info[], where the last element is a sentinel.
         StateInfo *info[3] =
           { next, next == pos.state() ? nullptr : pos.state(), nullptr };
-  #ifdef VECTOR
         for (IndexType j = 0; j < kHalfDimensions / kTileHeight; ++j)
         {
           // Load accumulator
-          auto accTile = reinterpret_cast<vec_t*>(
-            &st->accumulator.accumulation[c][0][j * kTileHeight]);
+          auto accTile = &st->accumulator.accumulation[c][0][j * kTileHeight];
           for (IndexType k = 0; k < kNumRegs; ++k)
-            acc[k] = vec_load(&accTile[k]);
+            acc[k] = Vec::load(&accTile[k * kLanes]);
 
           for (IndexType i = 0; info[i]; ++i)
           {
@@ -287,55 +334,24 @@ namespace Eval::NNUE {
             for (const auto index : removed[i])
             {
               const IndexType offset = kHalfDimensions * index + j * kTileHeight;
-              auto column = reinterpret_cast<const vec_t*>(&weights_[offset]);
               for (IndexType k = 0; k < kNumRegs; ++k)
-                acc[k] = vec_sub_16(acc[k], column[k]);
+                acc[k] = Vec::sub_16(acc[k], Vec::load(&weights_[offset + k * kLanes]));
             }
 
             // Difference calculation for the activated features
             for (const auto index : added[i])
             {
               const IndexType offset = kHalfDimensions * index + j * kTileHeight;
-              auto column = reinterpret_cast<const vec_t*>(&weights_[offset]);
               for (IndexType k = 0; k < kNumRegs; ++k)
-                acc[k] = vec_add_16(acc[k], column[k]);
+                acc[k] = Vec::add_16(acc[k], Vec::load(&weights_[offset + k * kLanes]));
             }
 
             // Store accumulator
-            accTile = reinterpret_cast<vec_t*>(
-              &info[i]->accumulator.accumulation[c][0][j * kTileHeight]);
+            accTile = &info[i]->accumulator.accumulation[c][0][j * kTileHeight];
             for (IndexType k = 0; k < kNumRegs; ++k)
-              vec_store(&accTile[k], acc[k]);
+              Vec::store(&accTile[k * kLanes], acc[k]);
           }
         }
-
-  #else
-        for (IndexType i = 0; info[i]; ++i)
-        {
-          std::memcpy(info[i]->accumulator.accumulation[c][0],
-              st->accumulator.accumulation[c][0],
-              kHalfDimensions * sizeof(BiasType));
-          st = info[i];
-
-          // Difference calculation for the deactivated features
-          for (const auto index : removed[i])
-          {
-            const IndexType offset = kHalfDimensions * index;
-
-            for (IndexType j = 0; j < kHalfDimensions; ++j)
-              st->accumulator.accumulation[c][0][j] -= weights_[offset + j];
-          }
-
-          // Difference calculation for the activated features
-          for (const auto index : added[i])
-          {
-            const IndexType offset = kHalfDimensions * index;
-
-            for (IndexType j = 0; j < kHalfDimensions; ++j)
-              st->accumulator.accumulation[c][0][j] += weights_[offset + j];
-          }
-        }
-  #endif
       }
       else
       {
@@ -345,46 +361,26 @@ namespace Eval::NNUE {
         Features::IndexList active;
         Features::HalfKP<Features::Side::kFriend>::AppendActiveIndices(pos, c, &active);
 
-  #ifdef VECTOR
         for (IndexType j = 0; j < kHalfDimensions / kTileHeight; ++j)
         {
-          auto biasesTile = reinterpret_cast<const vec_t*>(
-              &biases_[j * kTileHeight]);
           for (IndexType k = 0; k < kNumRegs; ++k)
-            acc[k] = biasesTile[k];
+            acc[k] = Vec::load(&biases_[j * kTileHeight + k * kLanes]);
 
           for (const auto index : active)
           {
             const IndexType offset = kHalfDimensions * index + j * kTileHeight;
-            auto column = reinterpret_cast<const vec_t*>(&weights_[offset]);
-
-            for (unsigned k = 0; k < kNumRegs; ++k)
-              acc[k] = vec_add_16(acc[k], column[k]);
+            for (IndexType k = 0; k < kNumRegs; ++k)
+              acc[k] = Vec::add_16(acc[k], Vec::load(&weights_[offset + k * kLanes]));
           }
 
-          auto accTile = reinterpret_cast<vec_t*>(
-              &accumulator.accumulation[c][0][j * kTileHeight]);
-          for (unsigned k = 0; k < kNumRegs; k++)
-            vec_store(&accTile[k], acc[k]);
-        }
-
-  #else
-        std::memcpy(accumulator.accumulation[c][0], biases_,
-            kHalfDimensions * sizeof(BiasType));
-
-        for (const auto index : active)
-        {
-          const IndexType offset = kHalfDimensions * index;
-
-          for (IndexType j = 0; j < kHalfDimensions; ++j)
-            accumulator.accumulation[c][0][j] += weights_[offset + j];
+          auto accTile = &accumulator.accumulation[c][0][j * kTileHeight];
+          for (IndexType k = 0; k < kNumRegs; ++k)
+            Vec::store(&accTile[k * kLanes], acc[k]);
         }
-  #endif
       }
 
-  #if defined(USE_MMX)
-      _mm_empty();
-  #endif
+      Vec::cleanup();
+      return refresh;
     }
 
     using BiasType = std::int16_t;
@@ -393,6 +389,8 @@ namespace Eval::NNUE {
     alignas(kCacheLineSize) BiasType biases_[kHalfDimensions];
     alignas(kCacheLineSize)
         WeightType weights_[kHalfDimensions * kInputDimensions];
+
+    int refresh_cost_, update_cost_;
   };
 
 }  // namespace Eval::NNUE
@@ -0,0 +1,458 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2020 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Vector operations used by the kernels of the NNUE evaluation function
+
+#ifndef NNUE_SIMD_H_INCLUDED
+#define NNUE_SIMD_H_INCLUDED
+
+#include <algorithm>
+#include <type_traits>
+
+#include "nnue_common.h"
+
+// Each instruction set is a struct of static functions over its register type
+// vec_t, all with the same names and semantics, so that the kernels are written
+// once for all of them:
+//
+//   kBytes            width of vec_t in bytes
+//   kNumRegs          number of registers used for an accumulator tile
+//   Half              the instruction set of half the width, or the same one
+//   zero()            all lanes zero
+//   load(p), store()  aligned load and store of kBytes bytes
+//   add_16, sub_16    lane-wise int16 addition and subtraction, wrapping
+//   packs_16(a, b)    the int16 lanes of a then b, clamped to [0, 127] as uint8
+//   packs_32(a..d)    the int32 lanes of a, b, c then d, shifted right by
+//                     kWeightScaleBits and clamped to [0, 127] as uint8
+//   madd(acc, a, b)   adds to each int32 lane of acc the products of the
+//                     uint8 lanes of a, at most 127, by the int8 lanes of b in
+//                     the same four bytes. Only the sum of all the lanes of acc
+//                     is meaningful: an implementation may spread the products
+//                     over the lanes differently.
+//   hsum(v)           sum of the int32 lanes of v
+//   hsum4(s, b, out)  out[k] = hsum(s[k]) + b[k] for k = 0..3
+//   cleanup()         to be called after the kernel, needed by MMX only
+//
+// The results are the same for every instruction set, the scalar one being the
+// reference. It is selected when no vector instruction set is enabled, or with
+// -DNNUE_SIMD_SCALAR for verification.
+
+namespace Eval::NNUE::Simd {
+
+  // Scalar reference implementation on 16 byte vectors
+  struct Scalar {
+
+    struct vec_t { alignas(16) std::uint8_t bytes[16]; };
+
+    static constexpr IndexType kBytes = 16;
+    static constexpr IndexType kNumRegs = 16;
+    using Half = Scalar;
+
+    template <typename T> static T lane(const vec_t& v, IndexType i) {
+      T x;
+      std::memcpy(&x, &v.bytes[i * sizeof(T)], sizeof(T));
+      return x;
+    }
+
+    template <typename T> static void set_lane(vec_t& v, IndexType i, T x) {
+      std::memcpy(&v.bytes[i * sizeof(T)], &x, sizeof(T));
+    }
+
+    static std::uint8_t clamp(int x) { return std::uint8_t(std::clamp(x, 0, 127)); }
+
+    static vec_t zero() { return vec_t{}; }
+    static vec_t load(const void* p) { vec_t v; std::memcpy(&v, p, kBytes); return v; }
+    static void store(void* p, vec_t v) { std::memcpy(p, &v, kBytes); }
+
+    static vec_t add_16(vec_t a, vec_t b) {
+      for (IndexType i = 0; i < 8; ++i)
+        set_lane<std::uint16_t>(a, i, lane<std::uint16_t>(a, i) + lane<std::uint16_t>(b, i));
+      return a;
+    }
+
+    static vec_t sub_16(vec_t a, vec_t b) {
+      for (IndexType i = 0; i < 8; ++i)
+        set_lane<std::uint16_t>(a, i, lane<std::uint16_t>(a, i) - lane<std::uint16_t>(b, i));
+      return a;
+    }
+
+    static vec_t packs_16(vec_t a, vec_t b) {
+      vec_t r;
+      for (IndexType i = 0; i < 8; ++i)
+      {
+        r.bytes[i]     = clamp(lane<std::int16_t>(a, i));
+        r.bytes[i + 8] = clamp(lane<std::int16_t>(b, i));
+      }
+      return r;
+    }
+
+    static vec_t packs_32(vec_t a, vec_t b, vec_t c, vec_t d) {
+      const vec_t in[] = { a, b, c, d };
+      vec_t r;
+      for (IndexType i = 0; i < 16; ++i)
+        r.bytes[i] = clamp(lane<std::int32_t>(in[i / 4], i % 4) >> kWeightScaleBits);
+      return r;
+    }
+
+    static void madd(vec_t& acc, vec_t a, vec_t b) {
+      for (IndexType i = 0; i < 4; ++i)
+      {
+        std::int32_t sum = lane<std::int32_t>(acc, i);
+        for (IndexType j = 4 * i; j < 4 * i + 4; ++j)
+          sum += a.bytes[j] * std::int8_t(b.bytes[j]);
+        set_lane<std::int32_t>(acc, i, sum);
+      }
+    }
+
+    static int hsum(vec_t v) {
+      return lane<std::int32_t>(v, 0) + lane<std::int32_t>(v, 1)
+           + lane<std::int32_t>(v, 2) + lane<std::int32_t>(v, 3);
+    }
+
+    static void hsum4(vec_t s0, vec_t s1, vec_t s2, vec_t s3,
+                      const std::int32_t* bias, std::int32_t* out) {
+      out[0] = hsum(s0) + bias[0];
+      out[1] = hsum(s1) + bias[1];
+      out[2] = hsum(s2) + bias[2];
+      out[3] = hsum(s3) + bias[3];
+    }
+
+    static void cleanup() {}
+  };
+
+#if defined(USE_AVX2)
+
+  struct Avx2 {
+
+    using vec_t = __m256i;
+
+    static constexpr IndexType kBytes = 32;
+    static constexpr IndexType kNumRegs = 16;
+    using Half = Avx2;
+
+    static vec_t zero() { return _mm256_setzero_si256(); }
+    static vec_t load(const void* p) { return _mm256_loadA_si256(static_cast<const vec_t*>(p)); }
+    static void store(void* p, vec_t v) { _mm256_storeA_si256(static_cast<vec_t*>(p), v); }
+    static vec_t add_16(vec_t a, vec_t b) { return _mm256_add_epi16(a, b); }
+    static vec_t sub_16(vec_t a, vec_t b) { return _mm256_sub_epi16(a, b); }
+
+    // The packs work within each 128 bit lane, hence the permutations
+    static vec_t packs_16(vec_t a, vec_t b) {
+      return _mm256_permute4x64_epi64(
+          _mm256_max_epi8(_mm256_packs_epi16(a, b), zero()), 0b11011000);
+    }
+
+    static vec_t packs_32(vec_t a, vec_t b, vec_t c, vec_t d) {
+      const vec_t words0 = _mm256_srai_epi16(_mm256_packs_epi32(a, b), kWeightScaleBits);
+      const vec_t words1 = _mm256_srai_epi16(_mm256_packs_epi32(c, d), kWeightScaleBits);
+      return _mm256_permutevar8x32_epi32(
+          _mm256_max_epi8(_mm256_packs_epi16(words0, words1), zero()),
+          _mm256_set_epi32(7, 3, 6, 2, 5, 1, 4, 0));
+    }
+
+    // The int16 sums of maddubs can not saturate as a is at most 127
+    static void madd(vec_t& acc, vec_t a, vec_t b) {
+  #if defined(USE_VNNI)
+      acc = _mm256_dpbusd_epi32(acc, a, b);
+  #else
+      acc = _mm256_add_epi32(acc, _mm256_madd_epi16(
+          _mm256_maddubs_epi16(a, b), _mm256_set1_epi16(1)));
+  #endif
+    }
+
+    static int hsum(vec_t v) {
+      __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+      sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E)); // _MM_PERM_BADC
+      sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1)); // _MM_PERM_CDAB
+      return _mm_cvtsi128_si32(sum);
+    }
+
+    static void hsum4(vec_t s0, vec_t s1, vec_t s2, vec_t s3,
+                      const std::int32_t* bias, std::int32_t* out) {
+      s0 = _mm256_hadd_epi32(_mm256_hadd_epi32(s0, s1), _mm256_hadd_epi32(s2, s3));
+      const __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(s0), _mm256_extracti128_si256(s0, 1));
+      _mm_store_si128(reinterpret_cast<__m128i*>(out),
+          _mm_add_epi32(sum, _mm_load_si128(reinterpret_cast<const __m128i*>(bias))));
+    }
+
+    static void cleanup() {}
+  };
+
+#endif
+
+#if defined(USE_AVX512)
+
+  struct Avx512 {
+
+    using vec_t = __m512i;
+
+    static constexpr IndexType kBytes = 64;
+    static constexpr IndexType kNumRegs = 8; // only 8 are needed
+    using Half = Avx2;
+
+    static vec_t zero() { return _mm512_setzero_si512(); }
+    static vec_t load(const void* p) { return _mm512_loadA_si512(p); }
+    static void store(void* p, vec_t v) { _mm512_storeA_si512(p, v); }
+    static vec_t add_16(vec_t a, vec_t b) { return _mm512_add_epi16(a, b); }
+    static vec_t sub_16(vec_t a, vec_t b) { return _mm512_sub_epi16(a, b); }
+
+    static vec_t packs_16(vec_t a, vec_t b) {
+      return _mm512_permutexvar_epi64(_mm512_setr_epi64(0, 2, 4, 6, 1, 3, 5, 7),
+          _mm512_max_epi8(_mm512_packs_epi16(a, b), zero()));
+    }
+
+    static vec_t packs_32(vec_t a, vec_t b, vec_t c, vec_t d) {
+      const vec_t words0 = _mm512_srai_epi16(_mm512_packs_epi32(a, b), kWeightScaleBits);
+      const vec_t words1 = _mm512_srai_epi16(_mm512_packs_epi32(c, d), kWeightScaleBits);
+      return _mm512_permutexvar_epi32(
+          _mm512_setr_epi32(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15),
+          _mm512_max_epi8(_mm512_packs_epi16(words0, words1), zero()));
+    }
+
+    static void madd(vec_t& acc, vec_t a, vec_t b) {
+  #if defined(USE_VNNI)
+      acc = _mm512_dpbusd_epi32(acc, a, b);
+  #else
+      acc = _mm512_add_epi32(acc, _mm512_madd_epi16(
+          _mm512_maddubs_epi16(a, b), _mm512_set1_epi16(1)));
+  #endif
+    }
+
+    static int hsum(vec_t v) { return _mm512_reduce_add_epi32(v); }
+
+    static void hsum4(vec_t s0, vec_t s1, vec_t s2, vec_t s3,
+                      const std::int32_t* bias, std::int32_t* out) {
+      const vec_t s01 = _mm512_add_epi32(_mm512_unpacklo_epi32(s0, s1), _mm512_unpackhi_epi32(s0, s1));
+      const vec_t s23 = _mm512_add_epi32(_mm512_unpacklo_epi32(s2, s3), _mm512_unpackhi_epi32(s2, s3));
+      const vec_t sum = _mm512_add_epi32(_mm512_unpacklo_epi64(s01, s23), _mm512_unpackhi_epi64(s01, s23));
+      const __m256i sum256 = _mm256_add_epi32(_mm512_castsi512_si256(sum), _mm512_extracti64x4_epi64(sum, 1));
+      const __m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum256), _mm256_extracti128_si256(sum256, 1));
+      _mm_store_si128(reinterpret_cast<__m128i*>(out),
+          _mm_add_epi32(sum128, _mm_load_si128(reinterpret_cast<const __m128i*>(bias))));
+    }
+
+    static void cleanup() {}
+  };
+
+#endif
+
+#if defined(USE_SSE2)
+
+  struct Sse2 {
+
+    using vec_t = __m128i;
+
+    static constexpr IndexType kBytes = 16;
+    static constexpr IndexType kNumRegs = Is64Bit ? 16 : 8;
+    using Half = Sse2;
+
+    static vec_t zero() { return _mm_setzero_si128(); }
+    static vec_t load(const void* p) { return _mm_load_si128(static_cast<const vec_t*>(p)); }
+    static void store(void* p, vec_t v) { _mm_store_si128(static_cast<vec_t*>(p), v); }
+    static vec_t add_16(vec_t a, vec_t b) { return _mm_add_epi16(a, b); }
+    static vec_t sub_16(vec_t a, vec_t b) { return _mm_sub_epi16(a, b); }
+
+    // Clamps the int8 lanes to [0, 127]. Without SSE4.1, the negative lanes
+    // saturate to -128 when offset by -128, and back to 0.
+    static vec_t clamp(vec_t v) {
+  #if defined(USE_SSE41)
+      return _mm_max_epi8(v, zero());
+  #else
+      const vec_t k0x80s = _mm_set1_epi8(-128);
+      return _mm_subs_epi8(_mm_adds_epi8(v, k0x80s), k0x80s);
+  #endif
+    }
+
+    static vec_t packs_16(vec_t a, vec_t b) { return clamp(_mm_packs_epi16(a, b)); }
+
+    static vec_t packs_32(vec_t a, vec_t b, vec_t c, vec_t d) {
+      const vec_t words0 = _mm_srai_epi16(_mm_packs_epi32(a, b), kWeightScaleBits);
+      const vec_t words1 = _mm_srai_epi16(_mm_packs_epi32(c, d), kWeightScaleBits);
+      return clamp(_mm_packs_epi16(words0, words1));
+    }
+
+    static void madd(vec_t& acc, vec_t a, vec_t b) {
+  #if defined(USE_SSSE3)
+      acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_maddubs_epi16(a, b), _mm_set1_epi16(1)));
+  #else
+      const vec_t signs = _mm_cmpgt_epi8(zero(), b);
+      const vec_t lo = _mm_madd_epi16(_mm_unpacklo_epi8(a, zero()), _mm_unpacklo_epi8(b, signs));
+      const vec_t hi = _mm_madd_epi16(_mm_unpackhi_epi8(a, zero()), _mm_unpackhi_epi8(b, signs));
+      acc = _mm_add_epi32(acc, _mm_add_epi32(lo, hi));
+  #endif
+    }
+
+    static int hsum(vec_t v) {
+      v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0x4E)); // _MM_PERM_BADC
+      v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0xB1)); // _MM_PERM_CDAB
+      return _mm_cvtsi128_si32(v);
+    }
+
+    static void hsum4(vec_t s0, vec_t s1, vec_t s2, vec_t s3,
+                      const std::int32_t* bias, std::int32_t* out) {
+  #if defined(USE_SSSE3)
+      s0 = _mm_hadd_epi32(_mm_hadd_epi32(s0, s1), _mm_hadd_epi32(s2, s3));
+      store(out, _mm_add_epi32(s0, load(bias)));
+  #else
+      out[0] = hsum(s0) + bias[0];
+      out[1] = hsum(s1) + bias[1];
+      out[2] = hsum(s2) + bias[2];
+      out[3] = hsum(s3) + bias[3];
+  #endif
+    }
+
+    static void cleanup() {}
+  };
+
+#elif defined(USE_MMX)
+
+  struct Mmx {
+
+    using vec_t = __m64;
+
+    static constexpr IndexType kBytes = 8;
+    static constexpr IndexType kNumRegs = 8;
+    using Half = Mmx;
+
+    static vec_t zero() { return _mm_setzero_si64(); }
+    static vec_t load(const void* p) { return *static_cast<const vec_t*>(p); }
+    static void store(void* p, vec_t v) { *static_cast<vec_t*>(p) = v; }
+    static vec_t add_16(vec_t a, vec_t b) { return _mm_add_pi16(a, b); }
+    static vec_t sub_16(vec_t a, vec_t b) { return _mm_sub_pi16(a, b); }
+
+    static vec_t clamp(vec_t v) {
+      const vec_t k0x80s = _mm_set1_pi8(-128);
+      return _mm_subs_pi8(_mm_adds_pi8(v, k0x80s), k0x80s);
+    }
+
+    static vec_t packs_16(vec_t a, vec_t b) { return clamp(_mm_packs_pi16(a, b)); }
+
+    static vec_t packs_32(vec_t a, vec_t b, vec_t c, vec_t d) {
+      const vec_t words0 = _mm_srai_pi16(_mm_packs_pi32(a, b), kWeightScaleBits);
+      const vec_t words1 = _mm_srai_pi16(_mm_packs_pi32(c, d), kWeightScaleBits);
+      return clamp(_mm_packs_pi16(words0, words1));
+    }
+
+    static void madd(vec_t& acc, vec_t a, vec_t b) {
+      const vec_t signs = _mm_cmpgt_pi8(zero(), b);
+      const vec_t lo = _mm_madd_pi16(_mm_unpacklo_pi8(a, zero()), _mm_unpacklo_pi8(b, signs));
+      const vec_t hi = _mm_madd_pi16(_mm_unpackhi_pi8(a, zero()), _mm_unpackhi_pi8(b, signs));
+      acc = _mm_add_pi32(acc, _mm_add_pi32(lo, hi));
+    }
+
+    static int hsum(vec_t v) {
+      return _mm_cvtsi64_si32(_mm_add_pi32(v, _mm_unpackhi_pi32(v, v)));
+    }
+
+    static void hsum4(vec_t s0, vec_t s1, vec_t s2, vec_t s3,
+                      const std::int32_t* bias, std::int32_t* out) {
+      out[0] = hsum(s0) + bias[0];
+      out[1] = hsum(s1) + bias[1];
+      out[2] = hsum(s2) + bias[2];
+      out[3] = hsum(s3) + bias[3];
+    }
+
+    static void cleanup() { _mm_empty(); }
+  };
+
+#elif defined(USE_NEON)
+
+  // The register type is int8x16_t, reinterpreted as needed by each operation
+  struct Neon {
+
+    using vec_t = int8x16_t;
+
+    static constexpr IndexType kBytes = 16;
+    static constexpr IndexType kNumRegs = 16;
+    using Half = Neon;
+
+    static vec_t zero() { return vdupq_n_s8(0); }
+    static vec_t load(const void* p) { return *static_cast<const vec_t*>(p); }
+    static void store(void* p, vec_t v) { *static_cast<vec_t*>(p) = v; }
+
+    static vec_t add_16(vec_t a, vec_t b) {
+      return vreinterpretq_s8_s16(vaddq_s16(vreinterpretq_s16_s8(a), vreinterpretq_s16_s8(b)));
+    }
+
+    static vec_t sub_16(vec_t a, vec_t b) {
+      return vreinterpretq_s8_s16(vsubq_s16(vreinterpretq_s16_s8(a), vreinterpretq_s16_s8(b)));
+    }
+
+    static vec_t packs_16(vec_t a, vec_t b) {
+      return vmaxq_s8(vcombine_s8(vqmovn_s16(vreinterpretq_s16_s8(a)),
+                                  vqmovn_s16(vreinterpretq_s16_s8(b))), zero());
+    }
+
+    static vec_t packs_32(vec_t a, vec_t b, vec_t c, vec_t d) {
+      const int16x8_t words0 = vcombine_s16(vqshrn_n_s32(vreinterpretq_s32_s8(a), kWeightScaleBits),
+                                            vqshrn_n_s32(vreinterpretq_s32_s8(b), kWeightScaleBits));
+      const int16x8_t words1 = vcombine_s16(vqshrn_n_s32(vreinterpretq_s32_s8(c), kWeightScaleBits),
+                                            vqshrn_n_s32(vreinterpretq_s32_s8(d), kWeightScaleBits));
+      return vmaxq_s8(vcombine_s8(vqmovn_s16(words0), vqmovn_s16(words1)), zero());
+    }
+
+    // a is at most 127, so that it can be multiplied as signed
+    static void madd(vec_t& acc, vec_t a, vec_t b) {
+      int16x8_t product = vmull_s8(vget_low_s8(a), vget_low_s8(b));
+      product = vmlal_s8(product, vget_high_s8(a), vget_high_s8(b));
+      acc = vreinterpretq_s8_s32(vpadalq_s16(vreinterpretq_s32_s8(acc), product));
+    }
+
+    static int hsum(vec_t v) {
+      const int32x4_t s = vreinterpretq_s32_s8(v);
+      return vgetq_lane_s32(s, 0) + vgetq_lane_s32(s, 1) + vgetq_lane_s32(s, 2) + vgetq_lane_s32(s, 3);
+    }
+
+    static void hsum4(vec_t s0, vec_t s1, vec_t s2, vec_t s3,
+                      const std::int32_t* bias, std::int32_t* out) {
+      out[0] = hsum(s0) + bias[0];
+      out[1] = hsum(s1) + bias[1];
+      out[2] = hsum(s2) + bias[2];
+      out[3] = hsum(s3) + bias[3];
+    }
+
+    static void cleanup() {}
+  };
+
+#endif
+
+  // The instruction set used by the kernels
+#if defined(NNUE_SIMD_SCALAR)
+  using Vec = Scalar;
+#elif defined(USE_AVX512)
+  using Vec = Avx512;
+#elif defined(USE_AVX2)
+  using Vec = Avx2;
+#elif defined(USE_SSE2)
+  using Vec = Sse2;
+#elif defined(USE_MMX)
+  using Vec = Mmx;
+#elif defined(USE_NEON)
+  using Vec = Neon;
+#else
+  using Vec = Scalar;
+#endif
+
+  // The widest instruction set whose width divides the given number of bytes.
+  // Layers too small for a full AVX-512 register fall back to AVX2.
+  template <IndexType Bytes>
+  using VecFor = std::conditional_t<Bytes % Vec::kBytes == 0, Vec, Vec::Half>;
+
+}  // namespace Eval::NNUE::Simd
+
+#endif // #ifndef NNUE_SIMD_H_INCLUDED
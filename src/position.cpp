@@ -189,7 +189,6 @@ Position& Position::set(const string& fenStr, bool isChess960, StateInfo* si, Th
 
   std::memset(this, 0, sizeof(Position));
   std::memset(si, 0, sizeof(StateInfo));
-  std::fill_n(&pieceList[0][0], sizeof(pieceList) / sizeof(Square), SQ_NONE);
   st = si;
 
   ss >> std::noskipws;
@@ -317,6 +316,7 @@ void Position::set_check_info(StateInfo* si) const {
   si->checkSquares[ROOK]   = attacks_from<ROOK>(ksq);
   si->checkSquares[QUEEN]  = si->checkSquares[BISHOP] | si->checkSquares[ROOK];
   si->checkSquares[KING]   = 0;
+  si->checkInfoSet = true;
 }
 
 
@@ -359,10 +359,12 @@ void Position::set_state(StateInfo* si) const {
 
   for (Piece pc : Pieces)
   {
+      int pieceCount = popcount(pieces(color_of(pc), type_of(pc)));
+
       if (type_of(pc) != PAWN && type_of(pc) != KING)
-          si->nonPawnMaterial[color_of(pc)] += pieceCount[pc] * PieceValue[MG][pc];
+          si->nonPawnMaterial[color_of(pc)] += pieceCount * PieceValue[MG][pc];
 
-      for (int cnt = 0; cnt < pieceCount[pc]; ++cnt)
+      for (int cnt = 0; cnt < pieceCount; ++cnt)
           si->materialKey ^= Zobrist::psq[pc][cnt];
   }
 }
@@ -612,7 +614,7 @@ bool Position::gives_check(Move m) const {
   Square to = to_sq(m);
 
   // Is there a direct check?
-  if (st->checkSquares[type_of(piece_on(from))] & to)
+  if (check_squares(type_of(piece_on(from))) & to)
       return true;
 
   // Is there a discovered check?
@@ -746,12 +748,12 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
 		  dp.to[1] = SQ_NONE;
 	  }
 
-      // Update board and piece lists
+      // Update board and bitboards
       remove_piece(captured, capsq);
 
       // Update material hash key and prefetch access to materialTable
       k ^= Zobrist::psq[captured][capsq];
-      st->materialKey ^= Zobrist::psq[captured][pieceCount[captured]];
+      st->materialKey ^= Zobrist::psq[captured][popcount(pieces(them, type_of(captured)))];
       prefetch(thisThread->materialTable[st->materialKey]);
 
       // Update incremental scores
@@ -827,8 +829,8 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
           // Update hash keys
           k ^= Zobrist::psq[pc][to] ^ Zobrist::psq[promotion][to];
           st->pawnKey ^= Zobrist::psq[pc][to];
-          st->materialKey ^=  Zobrist::psq[promotion][pieceCount[promotion]-1]
-                            ^ Zobrist::psq[pc][pieceCount[pc]];
+          st->materialKey ^=  Zobrist::psq[promotion][popcount(pieces(us, type_of(promotion))) - 1]
+                            ^ Zobrist::psq[pc][popcount(pieces(us, PAWN))];
 
           // Update incremental score
           st->psq += PSQT::psq[promotion][to] - PSQT::psq[pc][to];
@@ -859,13 +861,202 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
 
   sideToMove = ~sideToMove;
 
-  // Update king attacks used for fast check detection
-  set_check_info(st);
+  // King attacks used for fast check detection are computed on first use
+  st->checkInfoSet = false;
+
+  assert(pos_is_ok());
+}
+
+
+/// Position::do_capture() is do_move() for the moves of the quiescence search,
+/// captures other than en passant and promotions. It has no castling and en
+/// passant cases, and as the move is a capture or a pawn move, it always
+/// resets the rule 50 counter and never sets an en passant square.
+
+void Position::do_capture(Move m, StateInfo& newSt, bool givesCheck) {
+
+  assert(is_ok(m));
+  assert(&newSt != st);
+  assert(type_of(m) == PROMOTION || (type_of(m) == NORMAL && capture(m)));
+
+  thisThread->nodes.fetch_add(1, std::memory_order_relaxed);
+  Key k = st->key ^ Zobrist::side;
+
+  std::memcpy(&newSt, st, offsetof(StateInfo, key));
+  newSt.previous = st;
+  st = &newSt;
+
+  ++gamePly;
+  ++st->pliesFromNull;
+  st->rule50 = 0;
+
+  Color us = sideToMove;
+  Color them = ~us;
+  Square from = from_sq(m);
+  Square to = to_sq(m);
+  Piece pc = piece_on(from);
+  Piece captured = piece_on(to);
+
+  assert(color_of(pc) == us);
+  assert(captured == NO_PIECE || color_of(captured) == them);
+  assert(type_of(captured) != KING);
+
+  st->accumulator.state[WHITE] = Eval::NNUE::EMPTY;
+  st->accumulator.state[BLACK] = Eval::NNUE::EMPTY;
+  auto& dp = st->dirtyPiece;
+  dp.dirty_num = 1;
+  dp.piece[0] = pc;
+  dp.from[0] = from;
+  dp.to[0] = to;
+
+  if (captured)
+  {
+      if (type_of(captured) == PAWN)
+          st->pawnKey ^= Zobrist::psq[captured][to];
+      else
+          st->nonPawnMaterial[them] -= PieceValue[MG][captured];
+
+      dp.dirty_num = 2;
+      dp.piece[1] = captured;
+      dp.from[1] = to;
+      dp.to[1] = SQ_NONE;
+
+      remove_piece(captured, to);
+
+      k ^= Zobrist::psq[captured][to];
+      st->materialKey ^= Zobrist::psq[captured][popcount(pieces(them, type_of(captured)))];
+      prefetch(thisThread->materialTable[st->materialKey]);
+
+      st->psq -= PSQT::psq[captured][to];
+  }
+
+  k ^= Zobrist::psq[pc][from] ^ Zobrist::psq[pc][to];
+
+  if (st->epSquare != SQ_NONE)
+  {
+      k ^= Zobrist::enpassant[file_of(st->epSquare)];
+      st->epSquare = SQ_NONE;
+  }
+
+  if (st->castlingRights && (castlingRightsMask[from] | castlingRightsMask[to]))
+  {
+      int cr = castlingRightsMask[from] | castlingRightsMask[to];
+      k ^= Zobrist::castling[st->castlingRights & cr];
+      st->castlingRights &= ~cr;
+  }
+
+  move_piece(pc, from, to);
+
+  if (type_of(pc) == PAWN)
+  {
+      if (type_of(m) == PROMOTION)
+      {
+          Piece promotion = make_piece(us, promotion_type(m));
+
+          assert(relative_rank(us, to) == RANK_8);
+
+          remove_piece(pc, to);
+          put_piece(promotion, to);
+
+          dp.to[0] = SQ_NONE;
+          dp.piece[dp.dirty_num] = promotion;
+          dp.from[dp.dirty_num] = SQ_NONE;
+          dp.to[dp.dirty_num] = to;
+          dp.dirty_num++;
+
+          k ^= Zobrist::psq[pc][to] ^ Zobrist::psq[promotion][to];
+          st->pawnKey ^= Zobrist::psq[pc][to];
+          st->materialKey ^=  Zobrist::psq[promotion][popcount(pieces(us, type_of(promotion))) - 1]
+                            ^ Zobrist::psq[pc][popcount(pieces(us, PAWN))];
+          st->psq += PSQT::psq[promotion][to] - PSQT::psq[pc][to];
+          st->nonPawnMaterial[us] += PieceValue[MG][promotion];
+      }
+
+      st->pawnKey ^= Zobrist::psq[pc][from] ^ Zobrist::psq[pc][to];
+      prefetch2(thisThread->pawnsTable[st->pawnKey]);
+  }
+
+  st->psq += PSQT::psq[pc][to] - PSQT::psq[pc][from];
+  st->capturedPiece = captured;
+  st->key = k;
+  st->checkersBB = givesCheck ? attackers_to(square<KING>(them)) & pieces(us) : 0;
+
+  sideToMove = ~sideToMove;
+
+  st->checkInfoSet = false;
+
+  assert(pos_is_ok());
+}
+
+
+/// Position::undo_capture() unmakes a move made by do_capture()
+
+void Position::undo_capture(Move m) {
+
+  assert(is_ok(m));
+
+  sideToMove = ~sideToMove;
+
+  Color us = sideToMove;
+  Square from = from_sq(m);
+  Square to = to_sq(m);
+  Piece pc = piece_on(to);
+
+  assert(empty(from));
+
+  if (type_of(m) == PROMOTION)
+  {
+      remove_piece(pc, to);
+      pc = make_piece(us, PAWN);
+      put_piece(pc, to);
+  }
+
+  move_piece(pc, to, from);
+
+  if (st->capturedPiece)
+      put_piece(st->capturedPiece, to);
+
+  st = st->previous;
+  --gamePly;
 
   assert(pos_is_ok());
 }
 
 
+/// Position::dirty_piece() sets the pieces changed by a move as do_move() does,
+/// without doing the move. Castling is not supported.
+
+void Position::dirty_piece(Move m, DirtyPiece& dp) const {
+
+  assert(type_of(m) != CASTLING);
+
+  Square to = to_sq(m);
+  Piece captured = type_of(m) == ENPASSANT ? make_piece(~sideToMove, PAWN) : piece_on(to);
+
+  dp.dirty_num = 1;
+  dp.piece[0] = moved_piece(m);
+  dp.from[0] = from_sq(m);
+  dp.to[0] = to;
+
+  if (captured)
+  {
+      dp.dirty_num = 2;
+      dp.piece[1] = captured;
+      dp.from[1] = type_of(m) == ENPASSANT ? to - pawn_push(sideToMove) : to;
+      dp.to[1] = SQ_NONE;
+  }
+
+  if (type_of(m) == PROMOTION)
+  {
+      dp.to[0] = SQ_NONE;
+      dp.piece[dp.dirty_num] = make_piece(sideToMove, promotion_type(m));
+      dp.from[dp.dirty_num] = SQ_NONE;
+      dp.to[dp.dirty_num] = to;
+      dp.dirty_num++;
+  }
+}
+
+
 /// Position::undo_move() unmakes a move. When it returns, the position should
 /// be restored to exactly the same state as before the move was made.
 
@@ -962,7 +1153,8 @@ void Position::do_castling(Color us, Square from, Square& to, Square& rfrom, Squ
 
 
 /// Position::do(undo)_null_move() is used to do(undo) a "null move": It flips
-/// the side to move without executing any move on the board.
+/// the side to move without executing any move on the board. As no piece
+/// moves, the computed accumulators of the parent are taken over as they are.
 
 void Position::do_null_move(StateInfo& newSt) {
 
@@ -975,8 +1167,17 @@ void Position::do_null_move(StateInfo& newSt) {
 
   st->dirtyPiece.dirty_num = 0;
   st->dirtyPiece.piece[0] = NO_PIECE; // Avoid checks in UpdateAccumulator()
-  st->accumulator.state[WHITE] = Eval::NNUE::EMPTY;
-  st->accumulator.state[BLACK] = Eval::NNUE::EMPTY;
+
+  for (Color c : { WHITE, BLACK })
+      if (st->previous->accumulator.state[c] == Eval::NNUE::COMPUTED)
+      {
+          std::memcpy(st->accumulator.accumulation[c], st->previous->accumulator.accumulation[c],
+                      sizeof(st->accumulator.accumulation[c]));
+          st->accumulator.state[c] = Eval::NNUE::COMPUTED;
+          ++thisThread->nnueReuses;
+      }
+      else
+          st->accumulator.state[c] = Eval::NNUE::EMPTY;
 
   if (st->epSquare != SQ_NONE)
   {
@@ -992,7 +1193,7 @@ void Position::do_null_move(StateInfo& newSt) {
 
   sideToMove = ~sideToMove;
 
-  set_check_info(st);
+  st->checkInfoSet = false;
 
   assert(pos_is_ok());
 }
@@ -1064,6 +1265,8 @@ bool Position::see_ge(Move m, Value threshold) const {
   // but possibly an X-ray attacker added behind it.
   Bitboard attackers = attackers_to(to, occupied) & occupied;
 
+  check_info();
+
   while (true)
   {
       // The balance is negative only because we assumed we could win
@@ -1200,14 +1403,14 @@ bool Position::pos_is_ok() const {
   if (Fast)
       return true;
 
-  if (   pieceCount[W_KING] != 1
-      || pieceCount[B_KING] != 1
+  if (   popcount(pieces(WHITE, KING)) != 1
+      || popcount(pieces(BLACK, KING)) != 1
       || attackers_to(square<KING>(~sideToMove)) & pieces(sideToMove))
       assert(0 && "pos_is_ok: Kings");
 
   if (   (pieces(PAWN) & (Rank1BB | Rank8BB))
-      || pieceCount[W_PAWN] > 8
-      || pieceCount[B_PAWN] > 8)
+      || count<PAWN>(WHITE) > 8
+      || count<PAWN>(BLACK) > 8)
       assert(0 && "pos_is_ok: Pawns");
 
   if (   (pieces(WHITE) & pieces(BLACK))
@@ -1227,16 +1430,9 @@ bool Position::pos_is_ok() const {
       assert(0 && "pos_is_ok: State");
 
   for (Piece pc : Pieces)
-  {
-      if (   pieceCount[pc] != popcount(pieces(color_of(pc), type_of(pc)))
-          || pieceCount[pc] != std::count(board, board + SQUARE_NB, pc))
+      if (popcount(pieces(color_of(pc), type_of(pc))) != std::count(board, board + SQUARE_NB, pc))
           assert(0 && "pos_is_ok: Pieces");
 
-      for (int i = 0; i < pieceCount[pc]; ++i)
-          if (board[pieceList[pc][i]] != pc || index[pieceList[pc][i]] != i)
-              assert(0 && "pos_is_ok: Index");
-  }
-
   for (Color c = WHITE; c <= BLACK; ++c)
       for (CastlingSide s = KING_SIDE; s <= QUEEN_SIDE; s = CastlingSide(s + 1))
       {
@@ -0,0 +1,171 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2018 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+
+#include "evaluate.h"
+#include "misc.h"
+#include "position.h"
+#include "resultcache.h"
+#include "uci.h"
+
+namespace {
+
+  struct Entry {
+    Depth depth;
+    std::string info, bestmove;
+    uint64_t lastUse;
+  };
+
+  std::mutex mutex;
+  std::unordered_map<Key, Entry> entries;
+  size_t capacity;
+  uint64_t tick;
+
+  // repeated() returns true if the root position already occurred in the game.
+  // The search then scores repetitions of it differently from the same position
+  // reached without that history, so its result must not be shared.
+  bool repeated(const Position& pos) {
+
+    const StateInfo* st = pos.state();
+    int end = std::min(st->rule50, st->pliesFromNull);
+
+    if (end < 4)
+        return false;
+
+    const StateInfo* stp = st->previous->previous;
+
+    for (int i = 4; i <= end; i += 2)
+    {
+        stp = stp->previous->previous;
+        if (stp->key == st->key)
+            return true;
+    }
+
+    return false;
+  }
+
+  // cacheable() returns true for the requests whose result only depends on the
+  // position and the depth: no clock, node or mate limit, no searchmoves and
+  // no earlier occurrence of the root in the game.
+  bool cacheable(const Position& pos, const Search::LimitsType& limits) {
+
+    return    capacity
+           && limits.depth
+           && !limits.use_time_management()
+           && !limits.movetime && !limits.nodes && !limits.mate
+           && !limits.perft && !limits.infinite
+           && limits.searchmoves.empty()
+           && !repeated(pos);
+  }
+
+  // cache_key() mixes the position key with the rule 50 counter and the options
+  // that change the output.
+  Key cache_key(const Position& pos) {
+
+    return  pos.key()
+          ^ Key(int(Options["MultiPV"])) * 0x9E3779B97F4A7C15ULL
+          ^ Key(pos.rule50_count() + 1) * 0xC2B2AE3D27D4EB4FULL
+          ^ Key(std::hash<std::string>()(std::string(Options["Experience File"]))) * 0x165667B19E3779F9ULL
+          ^ (pos.is_chess960()           ? 0xA3B195354A39B70DULL : 0)
+          ^ (Eval::useNNUE               ? 0x1B873593CC9E2D51ULL : 0)
+          ^ (Options["NNUE Cheap Bound"] ? 0x85EBCA6B27D4EB2FULL : 0);
+  }
+
+  // evict() removes entries until the cache fits its capacity. The victim is
+  // the least recently used entry or, with "Analysis Cache Keep Deepest", the
+  // shallowest one, the least recently used among equals.
+  void evict() {
+
+    bool keepDeepest = Options["Analysis Cache Keep Deepest"];
+
+    while (entries.size() > capacity)
+        entries.erase(std::min_element(entries.begin(), entries.end(),
+                      [keepDeepest](const auto& a, const auto& b) {
+                          return keepDeepest && a.second.depth != b.second.depth
+                                ? a.second.depth < b.second.depth
+                                : a.second.lastUse < b.second.lastUse; }));
+  }
+
+} // namespace
+
+
+/// ResultCache::resize() sets the maximum number of entries, 0 disables the cache
+
+void ResultCache::resize(size_t n) {
+
+  std::lock_guard<std::mutex> lk(mutex);
+
+  capacity = n;
+  evict();
+}
+
+
+/// ResultCache::clear() drops all the entries, used when the evaluation changes
+
+void ResultCache::clear() {
+
+  std::lock_guard<std::mutex> lk(mutex);
+
+  entries.clear();
+}
+
+
+/// ResultCache::probe() looks for a stored result at least as deep as the
+/// request. On a hit the stored output is sent to the GUI and true is returned,
+/// so that no search is started.
+
+bool ResultCache::probe(const Position& pos, const Search::LimitsType& limits) {
+
+  if (!cacheable(pos, limits))
+      return false;
+
+  std::lock_guard<std::mutex> lk(mutex);
+
+  auto it = entries.find(cache_key(pos));
+  if (it == entries.end() || it->second.depth < limits.depth * ONE_PLY)
+      return false;
+
+  it->second.lastUse = ++tick;
+  sync_cout << it->second.info << "\n" << it->second.bestmove << sync_endl;
+  return true;
+}
+
+
+/// ResultCache::store() saves the output of a completed search. A shallower
+/// result never replaces a deeper one.
+
+void ResultCache::store(const Position& pos, const Search::LimitsType& limits, Depth depth,
+                        const std::string& info, const std::string& bestmove) {
+
+  if (!cacheable(pos, limits) || depth < limits.depth * ONE_PLY)
+      return;
+
+  std::lock_guard<std::mutex> lk(mutex);
+
+  Entry& e = entries[cache_key(pos)];
+
+  if (e.info.empty() || depth >= e.depth)
+      e = { depth, info, bestmove, ++tick };
+
+  evict();
+}
@@ -0,0 +1,46 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2018 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RESULTCACHE_H_INCLUDED
+#define RESULTCACHE_H_INCLUDED
+
+#include <string>
+
+#include "search.h"
+
+class Position;
+
+/// The ResultCache namespace remembers the output of completed depth limited
+/// searches, so that an identical "go depth N" request on the same position,
+/// with the same MultiPV, is answered at once by replaying the stored info
+/// lines and best move. A stored result of a deeper search also answers a
+/// request for a smaller depth.
+
+namespace ResultCache {
+
+void resize(size_t entries);
+void clear();
+bool probe(const Position& pos, const Search::LimitsType& limits);
+void store(const Position& pos, const Search::LimitsType& limits, Depth depth,
+           const std::string& info, const std::string& bestmove);
+
+} // namespace ResultCache
+
+#endif // #ifndef RESULTCACHE_H_INCLUDED
@@ -26,11 +26,15 @@
 #include <sstream>
 
 #include "evaluate.h"
+#include "experience.h"
+#include "mate.h"
 #include "misc.h"
 #include "movegen.h"
 #include "movepick.h"
 #include "position.h"
+#include "resultcache.h"
 #include "search.h"
+#include "searchtrace.h"
 #include "timeman.h"
 #include "thread.h"
 #include "tt.h"
@@ -84,6 +88,8 @@ namespace {
   Value value_to_tt(Value v, int ply);
   Value value_from_tt(Value v, int ply);
   void update_pv(Move* pv, Move move, Move* childPv);
+  void update_tt_stats(Thread* th, bool ttHit, const TTEntry* tte);
+  void batch_children(const Position& pos, Value futilityBase, Value alpha);
   void update_continuation_histories(Stack* ss, Piece pc, Square to, int bonus);
   void update_stats(const Position& pos, Stack* ss, Move move, Move* quiets, int quietsCnt, int bonus);
   void update_capture_stats(const Position& pos, Move move, Move* captures, int captureCnt, int bonus);
@@ -115,6 +121,23 @@ namespace {
     return nodes;
   }
 
+  // sort_root_moves() is a stable insertion sort of the root moves. Unlike
+  // std::stable_sort it does not allocate a temporary buffer, and the root
+  // moves are few and mostly sorted already.
+  void sort_root_moves(RootMoves::iterator begin, RootMoves::iterator end) {
+
+    for (auto p = begin; p != end; ++p)
+    {
+        RootMove tmp = std::move(*p);
+        auto q = p;
+
+        for ( ; q != begin && tmp < *(q - 1); --q)
+            *q = std::move(*(q - 1));
+
+        *q = std::move(tmp);
+    }
+  }
+
 } // namespace
 
 
@@ -168,10 +191,17 @@ void MainThread::search() {
       return;
   }
 
+#ifdef ALLOC_TRACKING
+  uint64_t allocations = heap_allocations();
+#endif
+
   Color us = rootPos.side_to_move();
   Time.init(Limits, us, rootPos.game_ply());
   TT.new_search();
 
+  if (int seeded = Experience::seed(rootPos))
+      sync_cout << "info string Experience seeded " << seeded << " positions" << sync_endl;
+
   Eval::NNUE::verify();
 
   if (rootMoves.empty())
@@ -232,16 +262,39 @@ void MainThread::search() {
 
   previousScore = bestThread->rootMoves[0].score;
 
+  // Only the exact score of the last completed iteration is worth keeping. The
+  // root moves may hold bounds from a failed high/low or an aborted iteration.
+  if (bestThread->completedMove.pv[0] != MOVE_NONE)
+      Experience::record(rootPos, bestThread->completedMove, bestThread->completedDepth);
+
+  // Without a legal move there is no PV to print or to cache
+  bool hasMove = bestThread->rootMoves[0].pv[0] != MOVE_NONE;
+  std::string info = hasMove ? UCI::pv(bestThread->rootPos, bestThread->completedDepth, -VALUE_INFINITE, VALUE_INFINITE) : "";
+
   // Send new PV when needed
   if (bestThread != this)
-      sync_cout << UCI::pv(bestThread->rootPos, bestThread->completedDepth, -VALUE_INFINITE, VALUE_INFINITE) << sync_endl;
+      sync_cout << info << sync_endl;
 
-  sync_cout << "bestmove " << UCI::move(bestThread->rootMoves[0].pv[0], rootPos.is_chess960());
+  std::string bestmove = "bestmove " + UCI::move(bestThread->rootMoves[0].pv[0], rootPos.is_chess960());
 
   if (bestThread->rootMoves[0].pv.size() > 1 || bestThread->rootMoves[0].extract_ponder_from_tt(rootPos))
-      std::cout << " ponder " << UCI::move(bestThread->rootMoves[0].pv[1], rootPos.is_chess960());
+      bestmove += " ponder " + UCI::move(bestThread->rootMoves[0].pv[1], rootPos.is_chess960());
 
-  std::cout << sync_endl;
+  if (hasMove)
+      ResultCache::store(rootPos, Limits, bestThread->completedDepth, info, bestmove);
+
+#ifdef ALLOC_TRACKING
+  allocations = heap_allocations() - allocations;
+  for (Thread* th : Threads)
+      if (th != this)
+          allocations += th->searchAllocations;
+
+  sync_cout << "info string Heap allocations " << allocations << sync_endl;
+#endif
+
+  sync_cout << bestmove << sync_endl;
+
+  SearchTrace::write("search.trace");
 }
 
 
@@ -268,29 +321,45 @@ void Thread::search() {
   if (mainThread)
   {
       mainThread->failedLow = false;
-      mainThread->bestMoveChanges = 0;
+      mainThread->totBestMoveChanges = 0;
   }
 
   size_t multiPV = Options["MultiPV"];
+  cheapBound = Eval::useNNUE && Options["NNUE Cheap Bound"];
+  batchEval = Eval::useNNUE && !childBatches.empty();
+  ttStats = Threads.ttStats;
 
   multiPV = std::min(multiPV, rootMoves.size());
 
+  // On "go mate" the helpers try the dedicated mate solver first. If it proves
+  // that there is no mate in the given number of moves, they go on with the
+  // normal search. The main thread only runs it when alone, see below.
+  bool sharedTM = mainThread && Options["Shared Time Management"];
+  bool mateSolver = Limits.mate && Options["Mate Solver"] && Options["MultiPV"] == 1;
+  if (mateSolver && !mainThread && Mate::search(*this))
+      return;
+
   // Iterative deepening loop until requested to stop or the target depth is reached
   while (   (rootDepth += ONE_PLY) < DEPTH_MAX
          && !Threads.stop
          && !(Limits.depth && mainThread && rootDepth / ONE_PLY > Limits.depth))
   {
-      // Distribute search depths across the threads
+      // Distribute search depths across the threads. The first 20 helpers use
+      // the skip-blocks, any further helper skips the depths already searched
+      // by half of the threads, so that they spread over the next depths.
       if (idx)
       {
-          int i = (idx - 1) % 20;
-          if (((rootDepth / ONE_PLY + rootPos.game_ply() + skipPhase[i]) / skipSize[i]) % 2)
+          int i = int(idx) - 1;
+          if (i < 20 ? ((rootDepth / ONE_PLY + rootPos.game_ply() + skipPhase[i]) / skipSize[i]) % 2
+                     : Threads.depthSearchers[rootDepth / ONE_PLY] >= int(Threads.size() + 1) / 2)
               continue;
       }
 
+      ++Threads.depthSearchers[rootDepth / ONE_PLY];
+
       // Age out PV variability metric
       if (mainThread)
-          mainThread->bestMoveChanges *= 0.505, mainThread->failedLow = false;
+          mainThread->totBestMoveChanges *= 0.505, mainThread->failedLow = false;
 
       // Save the last iteration's scores before first PV line is searched and
       // all the move scores except the (new) PV are set to -VALUE_INFINITE.
@@ -324,7 +393,7 @@ void Thread::search() {
               // and we want to keep the same order for all the moves except the
               // new PV that goes to the front. Note that in case of MultiPV
               // search the already searched PV lines are preserved.
-              std::stable_sort(rootMoves.begin() + PVIdx, rootMoves.end());
+              sort_root_moves(rootMoves.begin() + PVIdx, rootMoves.end());
 
               // If search has been stopped, we break immediately. Sorting and
               // writing PV back to TT is safe because RootMoves is still
@@ -364,15 +433,21 @@ void Thread::search() {
           }
 
           // Sort the PV lines searched so far and update the GUI
-          std::stable_sort(rootMoves.begin(), rootMoves.begin() + PVIdx + 1);
+          sort_root_moves(rootMoves.begin(), rootMoves.begin() + PVIdx + 1);
 
           if (    mainThread
               && (Threads.stop || PVIdx + 1 == multiPV || Time.elapsed() > 3000))
               sync_cout << UCI::pv(rootPos, rootDepth, alpha, beta) << sync_endl;
       }
 
+      --Threads.depthSearchers[rootDepth / ONE_PLY];
+
       if (!Threads.stop)
+      {
           completedDepth = rootDepth;
+          completedIteration = uint32_t(completedDepth) << 16 | rootMoves[0].pv[0];
+          completedMove = rootMoves[0];
+      }
 
       if (rootMoves[0].pv[0] != lastBestMove) {
          lastBestMove = rootMoves[0].pv[0];
@@ -385,6 +460,16 @@ void Thread::search() {
           && VALUE_MATE - bestValue <= 2 * Limits.mate)
           Threads.stop = true;
 
+      // Without helpers the main thread runs the mate solver, on a budget, once
+      // the first iteration has completed, so that a searched move is at hand.
+      if (   mainThread
+          && mateSolver
+          && Threads.size() == 1
+          && rootDepth == ONE_PLY
+          && !Threads.stop
+          && Mate::search(*this))
+          break;
+
       if (!mainThread)
           continue;
 
@@ -404,14 +489,43 @@ void Thread::search() {
                                && Limits.time[us] - Time.elapsed() > Limits.time[~us]
                                && ::pv_is_draw(rootPos);
 
-              double unstablePvFactor = 1 + mainThread->bestMoveChanges + thinkHard;
+              // With "Shared Time Management", collect the best move changes of
+              // all the threads, averaged over the threads. When every thread
+              // that completed our depth or more agrees with our best move, the
+              // deepest of them counts as the depth of that move.
+              Depth agreedDepth = completedDepth;
+
+              if (sharedTM)
+              {
+                  Depth deepest = completedDepth;
+                  bool agree = true;
+
+                  for (Thread* th : Threads)
+                  {
+                      mainThread->totBestMoveChanges += double(th->bestMoveChanges.exchange(0)) / Threads.size();
+
+                      uint32_t it = th->completedIteration;
+                      if (Depth(it >> 16) >= completedDepth)
+                      {
+                          agree &= Move(it & 0xFFFF) == lastBestMove;
+                          deepest = std::max(deepest, Depth(it >> 16));
+                      }
+                  }
+
+                  if (agree)
+                      agreedDepth = deepest;
+              }
+              else
+                  mainThread->totBestMoveChanges += double(bestMoveChanges.exchange(0));
+
+              double unstablePvFactor = 1 + mainThread->totBestMoveChanges + thinkHard;
 
               // if the bestMove is stable over several iterations, reduce time for this move,
               // the longer the move has been stable, the more.
               // Use part of the gained time from a previous stable move for the current move.
               timeReduction = 1;
               for (int i : {3, 4, 5})
-                  if (lastBestMoveDepth * i < completedDepth && !thinkHard)
+                  if (lastBestMoveDepth * i < agreedDepth && !thinkHard)
                      timeReduction *= 1.3;
               unstablePvFactor *=  std::pow(mainThread->previousTimeReduction, 0.51) / timeReduction;
 
@@ -473,6 +587,9 @@ namespace {
     bestValue = -VALUE_INFINITE;
     maxValue = VALUE_INFINITE;
 
+    TRACE_NODE(thisThread, (ss-1)->currentMove, alpha, beta, depth, ss->ply,
+               rootNode ? NODE_ROOT : PvNode ? NODE_PV : NODE_NON_PV, inCheck ? IN_CHECK : 0);
+
     // Check for the available remaining time
     if (thisThread == Threads.main())
         static_cast<MainThread*>(thisThread)->check_time();
@@ -513,10 +630,15 @@ namespace {
     excludedMove = ss->excludedMove;
     posKey = pos.key() ^ Key(excludedMove << 16); // isn't a very good hash
     tte = TT.probe(posKey, ttHit);
+    if (thisThread->ttStats)
+        update_tt_stats(thisThread, ttHit, tte);
     ttValue = ttHit ? value_from_tt(tte->value(), ss->ply) : VALUE_NONE;
     ttMove =  rootNode ? thisThread->rootMoves[thisThread->PVIdx].pv[0]
             : ttHit    ? tte->move() : MOVE_NONE;
 
+    if (ttHit)
+        TRACE_SET(TT_HIT);
+
     // At non-PV nodes we check for an early TT cutoff
     if (  !PvNode
         && ttHit
@@ -545,6 +667,7 @@ namespace {
                 update_continuation_histories(ss, pos.moved_piece(ttMove), to_sq(ttMove), penalty);
             }
         }
+        TRACE_CUT(CUT_TT);
         return ttValue;
     }
 
@@ -566,13 +689,56 @@ namespace {
         if (   ttValue != VALUE_NONE
             && (tte->bound() & (ttValue > eval ? BOUND_LOWER : BOUND_UPPER)))
             eval = ttValue;
+
+        TRACE_EVAL(eval != ss->staticEval ? EVAL_TT_VALUE : EVAL_TT, eval);
     }
     else
     {
+        // With NNUE, first try to settle razoring or futility pruning (Steps 6
+        // and 7) from the cheap linear readout and skip the full network if the
+        // bound is conclusive. The margin follows the observed readout error.
+        Value cheapEval = VALUE_NONE;
+        if (    thisThread->cheapBound
+            && !PvNode
+            && !skipEarlyPruning
+            &&  depth < 7 * ONE_PLY
+            && (ss-1)->currentMove != MOVE_NULL
+            &&  pos.non_pawn_material(pos.side_to_move())
+            && (cheapEval = Eval::evaluate_cheap(pos)) != VALUE_NONE)
+        {
+            Value margin = Value(3 * thisThread->cheapEvalError / 64);
+
+            if (   depth <= ONE_PLY
+                && cheapEval + margin + razor_margin <= alpha)
+            {
+                thisThread->cheapEvalCuts.fetch_add(1, std::memory_order_relaxed);
+                TRACE_EVAL(EVAL_CHEAP, cheapEval);
+                TRACE_CUT(CUT_CHEAP);
+                return qsearch<NonPV, false>(pos, ss, alpha, alpha+1);
+            }
+
+            if (   cheapEval - margin - futility_margin(depth) >= beta
+                && cheapEval - margin < VALUE_KNOWN_WIN)
+            {
+                thisThread->cheapEvalCuts.fetch_add(1, std::memory_order_relaxed);
+                TRACE_EVAL(EVAL_CHEAP, cheapEval);
+                TRACE_CUT(CUT_CHEAP);
+                return cheapEval - margin;
+            }
+        }
+
         eval = ss->staticEval =
         (ss-1)->currentMove != MOVE_NULL ? evaluate(pos)
                                          : -(ss-1)->staticEval + 2 * Eval::Tempo;
 
+        TRACE_EVAL((ss-1)->currentMove != MOVE_NULL ? EVAL_STATIC : EVAL_NULL_MOVE, eval);
+
+        if (cheapEval != VALUE_NONE)
+        {
+            thisThread->fullEvals.fetch_add(1, std::memory_order_relaxed);
+            thisThread->cheapEvalError += abs(eval - cheapEval) - thisThread->cheapEvalError / 64;
+        }
+
         tte->save(posKey, VALUE_NONE, BOUND_NONE, DEPTH_NONE, MOVE_NONE,
                   ss->staticEval, TT.generation());
     }
@@ -585,6 +751,8 @@ namespace {
         &&  depth < 4 * ONE_PLY
         &&  eval + razor_margin <= alpha)
     {
+        TRACE_CUT(CUT_RAZOR);
+
         if (depth <= ONE_PLY)
             return qsearch<NonPV, false>(pos, ss, alpha, alpha+1);
 
@@ -592,6 +760,8 @@ namespace {
         Value v = qsearch<NonPV, false>(pos, ss, ralpha, ralpha+1);
         if (v <= ralpha)
             return v;
+
+        TRACE_CUT(CUT_NONE);
     }
 
     // Step 7. Futility pruning: child node (skipped when in check)
@@ -599,7 +769,10 @@ namespace {
         &&  depth < 7 * ONE_PLY
         &&  eval - futility_margin(depth) >= beta
         &&  eval < VALUE_KNOWN_WIN)  // Do not return unproven wins
+    {
+        TRACE_CUT(CUT_FUTILITY);
         return eval;
+    }
 
     // Step 8. Null move search with verification search (is omitted in PV nodes)
     if (   !PvNode
@@ -627,6 +800,8 @@ namespace {
             if (nullValue >= VALUE_MATE_IN_MAX_PLY)
                 nullValue = beta;
 
+            TRACE_CUT(CUT_NULL_MOVE);
+
             if (abs(beta) < VALUE_KNOWN_WIN && (depth < 12 * ONE_PLY || thisThread->nmp_ply))
                 return nullValue;
 
@@ -642,6 +817,8 @@ namespace {
 
             if (v >= beta)
                 return nullValue;
+
+            TRACE_CUT(CUT_NONE);
         }
     }
 
@@ -669,7 +846,10 @@ namespace {
                 value = -search<NonPV>(pos, ss+1, -rbeta, -rbeta+1, depth - 4 * ONE_PLY, !cutNode, false);
                 pos.undo_move(move);
                 if (value >= rbeta)
+                {
+                    TRACE_CUT(CUT_PROBCUT);
                     return value;
+                }
             }
     }
 
@@ -691,6 +871,10 @@ moves_loop: // When in check search starts from here
     Move countermove = thisThread->counterMoves[pos.piece_on(prevSq)][prevSq];
 
     MovePicker mp(pos, ttMove, depth, &thisThread->mainHistory, &thisThread->captureHistory, contHist, countermove, ss->killers);
+
+    // The children of depth one nodes are evaluated by qsearch
+    if (thisThread->batchEval && depth == ONE_PLY && !inCheck && !rootNode && !ttMove)
+        batch_children(pos, VALUE_INFINITE, alpha);
     value = bestValue; // Workaround a bogus 'uninitialized' warning under gcc
     improving =   ss->staticEval >= (ss-2)->staticEval
             /* || ss->staticEval == VALUE_NONE Already implicit in the previous condition */
@@ -891,6 +1075,7 @@ moves_loop: // When in check search starts from here
           value = -search<NonPV>(pos, ss+1, -(alpha+1), -alpha, d, true, false);
 
           doFullDepthSearch = (value > alpha && d != newDepth);
+          TRACE_RESEARCH(thisThread, doFullDepthSearch);
       }
       else
           doFullDepthSearch = !PvNode || moveCount > 1;
@@ -910,6 +1095,7 @@ moves_loop: // When in check search starts from here
           (ss+1)->pv = pv;
           (ss+1)->pv[0] = MOVE_NONE;
 
+          TRACE_RESEARCH(thisThread, moveCount > 1);
           value = newDepth <   ONE_PLY ?
                             givesCheck ? -qsearch<PV,  true>(pos, ss+1, -beta, -alpha)
                                        : -qsearch<PV, false>(pos, ss+1, -beta, -alpha)
@@ -948,8 +1134,8 @@ moves_loop: // When in check search starts from here
               // We record how often the best move has been changed in each
               // iteration. This information is used for time management: When
               // the best move changes frequently, we allocate some more time.
-              if (moveCount > 1 && thisThread == Threads.main())
-                  ++static_cast<MainThread*>(thisThread)->bestMoveChanges;
+              if (moveCount > 1)
+                  ++thisThread->bestMoveChanges;
           }
           else
               // All other moves but the PV are set to the lowest value: this
@@ -974,6 +1160,7 @@ moves_loop: // When in check search starts from here
               else
               {
                   assert(value >= beta); // Fail high
+                  TRACE_BETA_CUT(moveCount);
                   break;
               }
           }
@@ -1071,6 +1258,9 @@ moves_loop: // When in check search starts from here
     (ss+1)->ply = ss->ply + 1;
     moveCount = 0;
 
+    TRACE_NODE(pos.this_thread(), (ss-1)->currentMove, alpha, beta, depth, ss->ply,
+               PvNode ? NODE_PV : NODE_NON_PV, QSEARCH | (InCheck ? IN_CHECK : 0));
+
     // Check for an instant draw or if the maximum ply has been reached
     if (pos.is_draw(ss->ply) || ss->ply >= MAX_PLY)
         return ss->ply >= MAX_PLY && !InCheck ? evaluate(pos) : VALUE_DRAW;
@@ -1085,16 +1275,24 @@ moves_loop: // When in check search starts from here
     // Transposition table lookup
     posKey = pos.key();
     tte = TT.probe(posKey, ttHit);
+    if (pos.this_thread()->ttStats)
+        update_tt_stats(pos.this_thread(), ttHit, tte);
     ttMove = ttHit ? tte->move() : MOVE_NONE;
     ttValue = ttHit ? value_from_tt(tte->value(), ss->ply) : VALUE_NONE;
 
+    if (ttHit)
+        TRACE_SET(TT_HIT);
+
     if (  !PvNode
         && ttHit
         && tte->depth() >= ttDepth
         && ttValue != VALUE_NONE // Only in case of TT access race
         && (ttValue >= beta ? (tte->bound() &  BOUND_LOWER)
                             : (tte->bound() &  BOUND_UPPER)))
+    {
+        TRACE_CUT(CUT_TT);
         return ttValue;
+    }
 
     // Evaluate the position statically
     if (InCheck)
@@ -1114,12 +1312,18 @@ moves_loop: // When in check search starts from here
             if (   ttValue != VALUE_NONE
                 && (tte->bound() & (ttValue > bestValue ? BOUND_LOWER : BOUND_UPPER)))
                 bestValue = ttValue;
+
+            TRACE_EVAL(bestValue != ss->staticEval ? EVAL_TT_VALUE : EVAL_TT, bestValue);
         }
         else
+        {
             ss->staticEval = bestValue =
             (ss-1)->currentMove != MOVE_NULL ? evaluate(pos)
                                              : -(ss-1)->staticEval + 2 * Eval::Tempo;
 
+            TRACE_EVAL((ss-1)->currentMove != MOVE_NULL ? EVAL_STATIC : EVAL_NULL_MOVE, bestValue);
+        }
+
         // Stand pat. Return immediately if static value is at least beta
         if (bestValue >= beta)
         {
@@ -1127,6 +1331,7 @@ moves_loop: // When in check search starts from here
                 tte->save(posKey, value_to_tt(bestValue, ss->ply), BOUND_LOWER,
                           DEPTH_NONE, MOVE_NONE, ss->staticEval, TT.generation());
 
+            TRACE_CUT(CUT_STAND_PAT);
             return bestValue;
         }
 
@@ -1142,6 +1347,9 @@ moves_loop: // When in check search starts from here
     // be generated.
     MovePicker mp(pos, ttMove, depth, &pos.this_thread()->mainHistory, &pos.this_thread()->captureHistory, to_sq((ss-1)->currentMove));
 
+    if (pos.this_thread()->batchEval && !InCheck && !ttMove)
+        batch_children(pos, futilityBase, alpha);
+
     // Loop through the moves until no moves remain or a beta cutoff occurs
     while ((move = mp.next_move()) != MOVE_NONE)
     {
@@ -1199,11 +1407,21 @@ moves_loop: // When in check search starts from here
 
       ss->currentMove = move;
 
-      // Make and search the move
-      pos.do_move(move, st, givesCheck);
+      // Make and search the move. Captures and promotions take the faster path.
+      bool capturePath = type_of(move) != ENPASSANT && pos.capture_or_promotion(move);
+
+      if (capturePath)
+          pos.do_capture(move, st, givesCheck);
+      else
+          pos.do_move(move, st, givesCheck);
+
       value = givesCheck ? -qsearch<NT,  true>(pos, ss+1, -beta, -alpha, depth - ONE_PLY)
                          : -qsearch<NT, false>(pos, ss+1, -beta, -alpha, depth - ONE_PLY);
-      pos.undo_move(move);
+
+      if (capturePath)
+          pos.undo_capture(move);
+      else
+          pos.undo_move(move);
 
       assert(value > -VALUE_INFINITE && value < VALUE_INFINITE);
 
@@ -1222,7 +1440,10 @@ moves_loop: // When in check search starts from here
               if (PvNode && value < beta) // Update alpha here!
                   alpha = value;
 			 else
+              {
+                  TRACE_BETA_CUT(moveCount);
                   break; // Fail high
+              }
 
           }
        }
@@ -1279,6 +1500,43 @@ moves_loop: // When in check search starts from here
   }
 
 
+  // update_tt_stats() counts the TT lookups at the start of each node, only when
+  // the bench reports them. A collision is a miss whose entry to be replaced still holds a
+  // position of the current search.
+
+  void update_tt_stats(Thread* th, bool ttHit, const TTEntry* tte) {
+
+    ++th->ttProbes;
+    th->ttHits += ttHit;
+    th->ttCollisions += !ttHit && tte->current(TT.generation());
+  }
+
+
+  // batch_children() evaluates together the children of a frontier node which
+  // are likely to be searched, see Eval::NNUE::evaluate_children(). These are
+  // the legal captures and queen promotions with a non-negative SEE, which
+  // pass futility pruning in qsearch. King moves need a refresh, and a single
+  // child is not worth a batch.
+
+  void batch_children(const Position& pos, Value futilityBase, Value alpha) {
+
+    constexpr int MaxSize = Eval::NNUE::ChildBatch::kMaxSize;
+    ExtMove list[MAX_MOVES], *end = generate<CAPTURES>(pos, list);
+    Move moves[MaxSize];
+    int n = 0;
+
+    for (ExtMove* m = list; m != end && n < MaxSize; ++m)
+        if (   type_of(pos.moved_piece(*m)) != KING
+            && futilityBase + PieceValue[EG][pos.piece_on(to_sq(*m))] > alpha
+            && pos.see_ge(*m)
+            && pos.legal(*m))
+            moves[n++] = *m;
+
+    if (n > 1)
+        Eval::NNUE::evaluate_children(pos, moves, n);
+  }
+
+
   // update_continuation_histories() updates histories of the move pairs formed
   // by moves at ply -1, -2, and -4 with current move.
 
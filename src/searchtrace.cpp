@@ -0,0 +1,248 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2018 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "searchtrace.h"
+#include "thread.h"
+#include "uci.h"
+
+// The trace file starts with a header, followed for each thread by a section
+// header and the records of the thread, oldest first.
+//
+//   Header:  "SFTR", version (uint32), number of threads (uint32)
+//   Section: thread index (uint32), padding (uint32), nodes entered (uint64),
+//            records stored (uint64), records
+
+namespace {
+
+  const char FileMagic[4] = { 'S', 'F', 'T', 'R' };
+  constexpr uint32_t Version = 1;
+
+  struct Section {
+    uint32_t idx, padding;
+    uint64_t entered, stored;
+  };
+
+  const char* CutoffNames[SearchTrace::CUTOFF_NB] = {
+    "none", "tt", "razor", "futility", "null move", "probcut", "cheap eval", "stand pat", "beta"
+  };
+
+} // namespace
+
+
+#ifdef SEARCH_TRACE
+
+/// Buffer::clear() empties the buffer, allocating it on first use
+
+void SearchTrace::Buffer::clear() {
+
+  if (records.empty())
+      records.resize(SEARCH_TRACE_SIZE);
+
+  head = 0;
+  depth = 0;
+  research = false;
+}
+
+
+SearchTrace::Scope::Scope(Buffer& b, Move m, Value alpha, Value beta, Depth d,
+                          int ply, NodeKind k, uint8_t flags) : buf(b) {
+
+  if (buf.research)
+      flags |= RESEARCH, buf.research = false;
+
+  if (buf.depth < Buffer::StackSize)
+      buf.stack[buf.depth] = buf.head;
+
+  ++buf.depth;
+  buf.at(buf.head++) = { uint16_t(m), int16_t(alpha), int16_t(beta), int16_t(VALUE_NONE),
+                         int8_t(d / ONE_PLY), uint8_t(ply), uint8_t(k), flags,
+                         EVAL_NONE, CUT_NONE, 0, 0 };
+}
+
+#endif
+
+
+/// SearchTrace::write() writes the buffers of all the threads to the given
+/// file. Without SEARCH_TRACE it does nothing.
+
+void SearchTrace::write(const std::string& fileName) {
+
+#ifdef SEARCH_TRACE
+  std::ofstream out(fileName, std::ios::binary);
+  uint32_t header[] = { Version, uint32_t(Threads.size()) };
+
+  out.write(FileMagic, sizeof(FileMagic));
+  out.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+  for (size_t i = 0; i < Threads.size(); ++i)
+  {
+      Buffer& buf = Threads[i]->trace;
+      Section s = { uint32_t(i), 0, buf.head, std::min(buf.head, uint64_t(SEARCH_TRACE_SIZE)) };
+
+      out.write(reinterpret_cast<const char*>(&s), sizeof(s));
+
+      for (uint64_t idx = buf.head - s.stored; idx < buf.head; ++idx)
+          out.write(reinterpret_cast<const char*>(&buf.at(idx)), sizeof(Record));
+  }
+
+  if (!out)
+      sync_cout << "info string Could not write search trace " << fileName << sync_endl;
+#else
+  (void)fileName;
+#endif
+}
+
+
+/// SearchTrace::summary() prints a summary of a trace file: the nodes and the
+/// effective branching factor per ply, the cutoffs, the re-searches and the
+/// largest quiescence search subtrees. The parent of each record is the last
+/// record entered one ply before, and a record is the child of a main search
+/// node if it is the first quiescence node along its path.
+
+void SearchTrace::summary(const std::string& fileName) {
+
+  struct Node { int ply; uint64_t idx; bool qsearch; };
+  struct Spot { uint64_t size; uint32_t thread; std::vector<Move> path; };
+
+  std::ifstream in(fileName, std::ios::binary);
+  char magic[4];
+  uint32_t header[2];
+
+  if (   !in.read(magic, sizeof(magic))
+      || !in.read(reinterpret_cast<char*>(header), sizeof(header))
+      || !std::equal(magic, magic + 4, FileMagic)
+      ||  header[0] != Version)
+  {
+      sync_cout << "info string Invalid search trace " << fileName << sync_endl;
+      return;
+  }
+
+  uint64_t nodes[MAX_PLY + 1] = {}, qnodes[MAX_PLY + 1] = {}, parents[MAX_PLY + 1] = {};
+  uint64_t researches[MAX_PLY + 1] = {}, cutoffs[CUTOFF_NB] = {}, firstMoveCuts = 0;
+  uint64_t entered = 0, stored = 0;
+  std::vector<Spot> spots;
+  int maxPly = 0;
+
+  for (uint32_t t = 0; t < header[1]; ++t)
+  {
+      Section s;
+      if (!in.read(reinterpret_cast<char*>(&s), sizeof(s)))
+          break;
+
+      std::vector<Record> records(s.stored);
+      in.read(reinterpret_cast<char*>(records.data()), s.stored * sizeof(Record));
+      records.resize(size_t(in.gcount() / sizeof(Record)));
+
+      entered += s.entered;
+      stored  += records.size();
+
+      std::vector<Node> stack;
+      std::vector<bool> expanded;
+
+      // Pops the nodes that can not be parents of a node at the given ply and
+      // keeps the largest quiescence search subtrees.
+      auto unwind = [&](int ply, uint64_t end) {
+          while (!stack.empty() && stack.back().ply >= ply)
+          {
+              Node n = stack.back();
+              stack.pop_back();
+
+              uint64_t size = end - n.idx;
+
+              if (   n.qsearch && (stack.empty() || !stack.back().qsearch)
+                  && (spots.size() < 10 || size > spots.back().size))
+              {
+                  Spot spot = { size, t, {} };
+                  for (const Node& a : stack)
+                      spot.path.push_back(Move(records[a.idx].move));
+                  spot.path.push_back(Move(records[n.idx].move));
+
+                  spots.push_back(spot);
+                  std::sort(spots.begin(), spots.end(), [](const Spot& a, const Spot& b) {
+                      return a.size > b.size; });
+                  if (spots.size() > 10)
+                      spots.pop_back();
+              }
+          }
+      };
+
+      for (uint64_t i = 0; i < records.size(); ++i)
+      {
+          const Record& r = records[i];
+          int ply = std::min(int(r.ply), MAX_PLY);
+
+          unwind(ply, i);
+
+          if (!stack.empty() && stack.back().ply == ply - 1 && !expanded[stack.size() - 1])
+              ++parents[ply - 1], expanded[stack.size() - 1] = true;
+
+          (r.flags & QSEARCH ? qnodes : nodes)[ply]++;
+          researches[ply] += bool(r.flags & RESEARCH);
+          cutoffs[std::min(int(r.cutoff), CUTOFF_NB - 1)]++;
+          firstMoveCuts += r.cutoff == CUT_BETA && r.cutMove == 1;
+          maxPly = std::max(maxPly, ply);
+
+          stack.push_back({ ply, i, bool(r.flags & QSEARCH) });
+          expanded.resize(stack.size());
+          expanded[stack.size() - 1] = false;
+      }
+
+      unwind(0, records.size());
+  }
+
+  std::stringstream ss;
+  ss << "Threads " << header[1] << ", nodes entered " << entered << ", records " << stored << "\n\n"
+     << " ply      nodes    qsearch   branching  re-searches\n";
+
+  for (int ply = 0; ply <= maxPly; ++ply)
+  {
+      uint64_t children = ply < maxPly ? nodes[ply + 1] + qnodes[ply + 1] : 0;
+
+      ss << std::setw(4)  << ply
+         << std::setw(11) << nodes[ply]
+         << std::setw(11) << qnodes[ply]
+         << std::setw(12) << std::fixed << std::setprecision(2)
+         << (parents[ply] ? double(children) / parents[ply] : 0.0)
+         << std::setw(13) << researches[ply] << "\n";
+  }
+
+  ss << "\nBranching is the average number of children of the nodes with children\n"
+     << "\nCutoffs:";
+  for (int c = CUT_TT; c < CUTOFF_NB; ++c)
+      ss << " " << CutoffNames[c] << " " << cutoffs[c] << ",";
+  ss << " first move " << (cutoffs[CUT_BETA] ? 100.0 * firstMoveCuts / cutoffs[CUT_BETA] : 0.0)
+     << "% of beta cutoffs\n"
+     << "\nLargest quiescence searches (nodes, thread, moves from the first record):\n";
+
+  for (const Spot& spot : spots)
+  {
+      ss << std::setw(9) << spot.size << std::setw(4) << spot.thread << " ";
+      for (Move m : spot.path)
+          ss << " " << (m == MOVE_NONE ? "root" : UCI::move(m, false));
+      ss << "\n";
+  }
+
+  sync_cout << ss.str() << sync_endl;
+}
@@ -0,0 +1,132 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2018 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SEARCHTRACE_H_INCLUDED
+#define SEARCHTRACE_H_INCLUDED
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "types.h"
+
+/// The SearchTrace namespace records the nodes visited by the search, for
+/// debugging search behaviour. Recording is only compiled in with "make
+/// trace=yes", which defines SEARCH_TRACE, otherwise the TRACE_ macros used by
+/// the search expand to nothing. Each thread appends a record per node, in the
+/// order the nodes are entered, to its own ring buffer, so that only the last
+/// nodes are kept on long searches. The buffers are written to a binary file
+/// at the end of each "go", and the "tracestat" command summarises the file.
+
+namespace SearchTrace {
+
+enum NodeKind : uint8_t { NODE_NON_PV, NODE_PV, NODE_ROOT };
+
+enum Flags : uint8_t { QSEARCH = 1, TT_HIT = 2, IN_CHECK = 4, RESEARCH = 8 };
+
+enum EvalSource : uint8_t {
+  EVAL_NONE, EVAL_TT, EVAL_TT_VALUE, EVAL_STATIC, EVAL_NULL_MOVE, EVAL_CHEAP
+};
+
+enum Cutoff : uint8_t {
+  CUT_NONE, CUT_TT, CUT_RAZOR, CUT_FUTILITY, CUT_NULL_MOVE, CUT_PROBCUT,
+  CUT_CHEAP, CUT_STAND_PAT, CUT_BETA, CUTOFF_NB
+};
+
+/// Record is the 16 byte entry stored per node. The move is the one leading
+/// to the node, and cutMove is the move count of the move that failed high
+/// for CUT_BETA.
+struct Record {
+  uint16_t move;
+  int16_t alpha, beta, eval;
+  int8_t depth;
+  uint8_t ply, kind, flags, evalSource, cutoff, cutMove, padding;
+};
+
+static_assert(sizeof(Record) == 16, "Record size incorrect");
+
+#ifdef SEARCH_TRACE
+
+#ifndef SEARCH_TRACE_SIZE
+#define SEARCH_TRACE_SIZE (1 << 20) // Records per thread, a power of 2
+#endif
+
+/// Buffer is the ring buffer of a thread. Nodes still being searched are kept
+/// on a stack, so that their records can be completed once the TT, the eval
+/// and the cutoff are known.
+struct Buffer {
+
+  static constexpr int StackSize = 4 * MAX_PLY; // Allows for nested searches at the same ply
+
+  void clear();
+  Record& at(uint64_t idx) { return records[idx & (SEARCH_TRACE_SIZE - 1)]; }
+  Record* top() {
+    return   depth <= StackSize && head - stack[depth - 1] <= SEARCH_TRACE_SIZE
+           ? &at(stack[depth - 1]) : nullptr;
+  }
+
+  std::vector<Record> records;
+  uint64_t head, stack[StackSize];
+  int depth;
+  bool research;
+};
+
+/// Scope records a node on construction and removes it from the stack of the
+/// nodes being searched on destruction.
+struct Scope {
+
+  Scope(Buffer& b, Move m, Value alpha, Value beta, Depth d, int ply, NodeKind k, uint8_t flags);
+  ~Scope() { --buf.depth; }
+
+  void set(uint8_t flag) { if (Record* r = buf.top()) r->flags |= flag; }
+  void eval(EvalSource es, Value v) { if (Record* r = buf.top()) r->evalSource = es, r->eval = int16_t(v); }
+  void cut(Cutoff c, int moveCount = 0) { if (Record* r = buf.top()) r->cutoff = c, r->cutMove = uint8_t(std::min(moveCount, 255)); }
+
+  Buffer& buf;
+};
+
+// The arguments of the macros may use the names of the SearchTrace namespace
+// unqualified, and are not evaluated when tracing is not compiled in.
+#define TRACE_NODE(th, ...) \
+  SearchTrace::Scope traceNode = [&]() { using namespace SearchTrace; \
+                                         return Scope((th)->trace, __VA_ARGS__); }()
+#define TRACE_SET(flag) do { using namespace SearchTrace; traceNode.set(flag); } while (0)
+#define TRACE_EVAL(es, v) do { using namespace SearchTrace; traceNode.eval(es, v); } while (0)
+#define TRACE_CUT(c) do { using namespace SearchTrace; traceNode.cut(c); } while (0)
+#define TRACE_BETA_CUT(moveCount) traceNode.cut(SearchTrace::CUT_BETA, moveCount)
+#define TRACE_RESEARCH(th, b) ((th)->trace.research = (b))
+
+#else
+
+#define TRACE_NODE(th, ...)
+#define TRACE_SET(flag) (void)0
+#define TRACE_EVAL(es, v) (void)0
+#define TRACE_CUT(c) (void)0
+#define TRACE_BETA_CUT(moveCount) (void)0
+#define TRACE_RESEARCH(th, b) (void)0
+
+#endif
+
+void write(const std::string& fileName);
+void summary(const std::string& fileName);
+
+} // namespace SearchTrace
+
+#endif // #ifndef SEARCHTRACE_H_INCLUDED
@@ -21,6 +21,7 @@
 #include <algorithm> // For std::count
 #include <cassert>
 
+#include "evaluate.h"
 #include "movegen.h"
 #include "search.h"
 #include "thread.h"
@@ -34,6 +35,8 @@ ThreadPool Threads; // Global object
 
 Thread::Thread(size_t n) : idx(n), stdThread(&Thread::idle_loop, this) {
 
+  numaNode = Options["NUMA Replication"] ? Numa::node_of(idx) : 0;
+
   wait_for_search_finished();
 }
 
@@ -64,6 +67,10 @@ void Thread::clear() {
           h.fill(0);
 
   contHistory[NO_PIECE][0].fill(Search::CounterMovePruneThreshold - 1);
+
+  // Start with a large readout error so that the cheap bound decides nothing
+  // until it has been calibrated against the full network.
+  cheapEvalError = 64 * VALUE_KNOWN_WIN;
 }
 
 /// Thread::start_searching() wakes up the thread that will start the search
@@ -95,8 +102,12 @@ void Thread::idle_loop() {
   // the choice, eventually we are one of many one-threaded processes running on
   // some Windows NUMA hardware, for instance in fishtest. To make it simple,
   // just check if running threads are below a threshold, in this case all this
-  // NUMA machinery is not needed.
-  if (Options["Threads"] >= 8)
+  // NUMA machinery is not needed. The replication binding only exists where
+  // several nodes are reported, elsewhere fall back to the processor groups.
+  if (Options["NUMA Replication"] && Numa::node_count() > 1)
+      Numa::bind_this_thread(Numa::node_of(idx));
+
+  else if (Options["Threads"] >= 8)
       WinProcGroup::bindThisThread(idx);
 
   while (true)
@@ -111,29 +122,50 @@ void Thread::idle_loop() {
 
       lk.unlock();
 
+      uint64_t allocations = heap_allocations();
       search();
+      searchAllocations = heap_allocations() - allocations;
   }
 }
 
 /// ThreadPool::set() creates/destroys threads to match the requested number.
 /// Created and launced threads wil go immediately to sleep in idle_loop.
-/// Upon resizing, threads are recreated to allow for binding if necessary.
+/// Surviving threads keep their state. New threads are constructed and
+/// cleared in parallel, as zeroing their tables dominates the cost.
 
 void ThreadPool::set(size_t requested) {
 
-  if (size() > 0) { // destroy any existing thread(s)
+  if (size() > 0) // destroy the threads in excess
+  {
       main()->wait_for_search_finished();
 
-      while (size() > 0)
+      while (size() > requested)
           delete back(), pop_back();
   }
 
-  if (requested > 0) { // create new thread(s)
-      push_back(new MainThread(0));
-
-      while (size() < requested)
-          push_back(new Thread(size()));
-      clear();
+  if (size() < requested) // create the missing thread(s)
+  {
+      size_t first = size();
+      std::vector<std::thread> builders;
+
+      resize(requested, nullptr);
+
+      for (size_t i = first; i < requested; ++i)
+          builders.emplace_back([this, i]() {
+              Thread* th = i ? new Thread(i) : new MainThread(0);
+              th->clear();
+              (*this)[i] = th;
+          });
+
+      for (std::thread& b : builders)
+          b.join();
+
+      if (first == 0)
+      {
+          main()->callsCnt = 0;
+          main()->previousScore = VALUE_INFINITE;
+          main()->previousTimeReduction = 1;
+      }
   }
 }
 
@@ -159,6 +191,9 @@ void ThreadPool::start_thinking(Position& pos, StateListPtr& states,
 
   stopOnPonderhit = stop = false;
   ponder = ponderMode;
+
+  for (auto& n : depthSearchers)
+      n = 0;
   Search::Limits = limits;
   Search::RootMoves rootMoves;
 
@@ -184,12 +219,47 @@ void ThreadPool::start_thinking(Position& pos, StateListPtr& states,
   for (Thread* th : *this)
   {
       th->nodes = th->tbHits = th->nmp_ply = th->nmp_odd = 0;
+      th->cheapEvalCuts = th->fullEvals = th->bestMoveChanges = 0;
+      th->ttProbes = th->ttHits = th->ttCollisions = 0;
+      th->nnueRefreshes = th->nnueReuses = th->nnueBatched = th->nnueBatchHits = 0;
       th->rootDepth = th->completedDepth = DEPTH_ZERO;
+      th->completedIteration = 0;
+#ifdef SEARCH_TRACE
+      th->trace.clear();
+#endif
       th->rootMoves = rootMoves;
+
+      // Reserve the longest PV, so that the search never grows it
+      for (auto& rm : th->rootMoves)
+          rm.pv.reserve(MAX_PLY + 1);
+
+      th->completedMove.pv.reserve(MAX_PLY + 1);
+      th->completedMove.pv.assign(1, MOVE_NONE);
+
+      // Batches of a previous search may come from another net. An empty
+      // vector turns batching off in Thread::search(), so free it when the
+      // option has been switched off.
+      if (Options["NNUE Batch Eval"])
+          th->childBatches.resize(MAX_PLY);
+      else
+      {
+          th->childBatches.clear();
+          th->childBatches.shrink_to_fit();
+      }
+      for (auto& b : th->childBatches)
+          b.size = 0;
+
       th->rootPos.set(pos.fen(), pos.is_chess960(), &setupStates->back(), th);
   }
 
   setupStates->back() = tmp;
 
+  // The threads share the root StateInfo, so its check info and accumulators
+  // are computed here once, before the threads read them.
+  main()->rootPos.check_info();
+
+  if (Eval::useNNUE)
+      Eval::NNUE::update_accumulators(main()->rootPos);
+
   main()->start_searching();
 }
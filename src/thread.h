@@ -32,6 +32,7 @@
 #include "pawns.h"
 #include "position.h"
 #include "search.h"
+#include "searchtrace.h"
 #include "thread_win32.h"
 
 
@@ -60,13 +61,25 @@ public:
   Pawns::Table pawnsTable;
   Material::Table materialTable;
   Endgames endgames;
-  size_t PVIdx;
+  size_t PVIdx, numaNode;
   int selDepth, nmp_ply, nmp_odd;
-  std::atomic<uint64_t> nodes, tbHits;
+  std::atomic<uint64_t> nodes, tbHits, cheapEvalCuts, fullEvals, bestMoveChanges;
+  uint64_t ttProbes, ttHits, ttCollisions; // Only read once the search is finished
+  uint64_t nnueRefreshes, nnueReuses;       // Accumulators refreshed, taken over by null moves
+  uint64_t nnueBatched, nnueBatchHits;      // Children evaluated in batches, then found there
+  bool cheapBound, batchEval = false, ttStats = false;
+  int cheapEvalError;
 
   Position rootPos;
   Search::RootMoves rootMoves;
   Depth rootDepth, completedDepth;
+  std::atomic<uint32_t> completedIteration; // Depth << 16 | best move, read by the main thread
+  Search::RootMove completedMove = Search::RootMove(MOVE_NONE); // Exact best line of completedDepth
+  uint64_t searchAllocations;
+  std::vector<Eval::NNUE::ChildBatch> childBatches; // One per ply, see evaluate_children()
+#ifdef SEARCH_TRACE
+  SearchTrace::Buffer trace;
+#endif
   CounterMoveHistory counterMoves;
   ButterflyHistory mainHistory;
   CapturePieceToHistory captureHistory;
@@ -84,7 +97,7 @@ struct MainThread : public Thread {
   void check_time();
 
   bool failedLow;
-  double bestMoveChanges, previousTimeReduction;
+  double totBestMoveChanges, previousTimeReduction;
   Value previousScore;
   int callsCnt;
 };
@@ -103,8 +116,19 @@ struct ThreadPool : public std::vector<Thread*> {
   MainThread* main()        const { return static_cast<MainThread*>(front()); }
   uint64_t nodes_searched() const { return accumulate(&Thread::nodes); }
   uint64_t tb_hits()        const { return accumulate(&Thread::tbHits); }
+  uint64_t cheap_eval_cuts() const { return accumulate(&Thread::cheapEvalCuts); }
+  uint64_t full_evals()     const { return accumulate(&Thread::fullEvals); }
+  uint64_t tt_probes()      const { return accumulate(&Thread::ttProbes); }
+  uint64_t tt_hits()        const { return accumulate(&Thread::ttHits); }
+  uint64_t tt_collisions()  const { return accumulate(&Thread::ttCollisions); }
+  uint64_t nnue_refreshes() const { return accumulate(&Thread::nnueRefreshes); }
+  uint64_t nnue_reuses()    const { return accumulate(&Thread::nnueReuses); }
+  uint64_t nnue_batched()   const { return accumulate(&Thread::nnueBatched); }
+  uint64_t nnue_batch_hits() const { return accumulate(&Thread::nnueBatchHits); }
 
   std::atomic_bool stop, ponder, stopOnPonderhit;
+  std::atomic<int> depthSearchers[MAX_PLY]; // Threads searching each root depth
+  bool ttStats = false; // Count the TT probes, hits and collisions, set by bench
 
 private:
   StateListPtr setupStates;
@@ -116,6 +140,14 @@ private:
         sum += (th->*member).load(std::memory_order_relaxed);
     return sum;
   }
+
+  uint64_t accumulate(uint64_t Thread::* member) const {
+
+    uint64_t sum = 0;
+    for (Thread* th : *this)
+        sum += th->*member;
+    return sum;
+  }
 };
 
 extern ThreadPool Threads;
@@ -18,11 +18,18 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <cstddef>   // For offsetof
 #include <cstring>   // For std::memset
 #include <iostream>
 
+#if defined(USE_SSE41)
+#include <smmintrin.h>
+#endif
+
 #include "bitboard.h"
+#include "search.h"
 #include "tt.h"
+#include "uci.h"
 
 TranspositionTable TT; // Our global transposition table
 
@@ -30,8 +37,9 @@ TranspositionTable TT; // Our global transposition table
 /// TranspositionTable::resize() sets the size of the transposition table,
 /// measured in megabytes. Transposition table consists of a power of 2 number
 /// of clusters and each cluster consists of ClusterSize number of TTEntry.
+/// Without clearTable the caller must clear the new table before using it.
 
-void TranspositionTable::resize(size_t mbSize) {
+void TranspositionTable::resize(size_t mbSize, bool clearTable) {
 
   size_t newClusterCount = mbSize * 1024 * 1024 / sizeof(Cluster);
 
@@ -51,7 +59,66 @@ void TranspositionTable::resize(size_t mbSize) {
   }
 
   table = (Cluster*)((uintptr_t(mem) + CacheLineSize - 1) & ~(CacheLineSize - 1));
-  clear();
+
+  if (clearTable)
+      clear();
+}
+
+
+/// TranspositionTable::auto_size() adapts the size of the table before each
+/// search when the "Auto Hash" option is set, "Hash" being the smallest size.
+/// The table should have room for twice the nodes that the search may visit,
+/// estimated from the time control at a nominal speed per thread. This estimate
+/// is corrected by hashfull() at the end of the previous search: doubled when
+/// the table was more than half full, halved back when it was barely used. The
+/// size is rounded up to a power of 2 MB, so that it changes rarely, and the
+/// table takes at most half of the memory left to the process, see
+/// available_memory(), counting the table itself as free. If that is unknown
+/// the table is not grown. Without a time or node limit, as in analysis, the
+/// size is kept. A new table is not cleared here, as go() calls Search::clear()
+/// right after.
+
+void TranspositionTable::auto_size(const Search::LimitsType& limits, Color us, size_t threads) {
+
+  constexpr size_t MB = 1024 * 1024;
+  constexpr int64_t NodesPerMs = 1000; // Per thread, on the low side
+
+  if (   !limits.nodes && !limits.movetime
+      && !(limits.use_time_management() && limits.time[us]))
+      return;
+
+  const size_t size = clusterCount * sizeof(Cluster) / MB;
+  const size_t available = available_memory();
+  const int full = hashfull();
+
+  if (full > 500 && autoScale < 1024)
+      autoScale *= 2;
+  else if (full < 100 && autoScale > 1)
+      autoScale /= 2;
+
+  int64_t nodes = limits.nodes;
+  if (!nodes)
+  {
+      TimePoint time =  limits.movetime ? limits.movetime
+                      : limits.time[us] / (limits.movestogo ? limits.movestogo : 20) + limits.inc[us];
+      nodes = time * NodesPerMs * int64_t(threads);
+  }
+
+  size_t target = std::max(size_t(nodes * 2 * sizeof(Cluster) / ClusterSize / MB), size_t(1));
+  target = std::max(target * autoScale, size_t(Options["Hash"]));
+
+  size_t newSize = 1;
+  while (newSize < target)
+      newSize *= 2;
+
+  size_t maxSize = available ? (available / MB + size) / 2 : std::max(size, size_t(Options["Hash"]));
+  newSize = std::min({ newSize, maxSize, size_t(MaxHashMB) });
+
+  if (newSize != size && newSize)
+  {
+      resize(newSize, false);
+      sync_cout << "info string Hash " << newSize << " MB" << sync_endl;
+  }
 }
 
 
@@ -71,12 +138,95 @@ void TranspositionTable::clear() {
 /// to be replaced later. The replace value of an entry is calculated as its depth
 /// minus 8 times its relative age. TTEntry t1 is considered more valuable than
 /// TTEntry t2 if its replace value is greater than that of t2.
+///
+/// With SSE4.1 the entries of the cluster are compared all at once. The cluster
+/// is loaded as two 16 byte halves, the key16 fields are compared as 16 bit
+/// lanes, and the genBound8 and depth8 fields are gathered by byte shuffles,
+/// one entry per 16 bit lane, to compute the replace values together. Any
+/// cluster of 32 bytes with up to 8 entries is supported, the results are the
+/// same as those of the scalar loops.
 
 TTEntry* TranspositionTable::probe(const Key key, bool& found) const {
 
   TTEntry* const tte = first_entry(key);
   const uint16_t key16 = key >> 48;  // Use the high 16 bits as key inside the cluster
 
+#if defined(USE_SSE41)
+
+  static_assert(sizeof(Cluster) == 32 && ClusterSize <= 8 && sizeof(TTEntry) % 2 == 0,
+                "Cluster layout not supported by the SIMD probe");
+
+  // Shuffle controls putting the genBound8 fields in the low bytes and the
+  // depth8 fields in the high bytes of the lanes, for each half, the lanes of
+  // no entry, and the bits of the key16 fields in a byte mask of the cluster.
+  struct Masks {
+    alignas(16) int8_t gen[2][16], depth[2][16];
+    alignas(16) int16_t unused[8];
+    uint32_t keys;
+  };
+
+  static constexpr Masks masks = [] {
+      Masks m = {};
+      for (int i = 0; i < 8; ++i)
+      {
+          for (int h = 0; h < 2; ++h)
+              m.gen[h][2 * i] = m.gen[h][2 * i + 1] = m.depth[h][2 * i] = m.depth[h][2 * i + 1] = -128;
+
+          if (i >= ClusterSize)
+          {
+              m.unused[i] = -1;
+              continue;
+          }
+
+          int k = i * sizeof(TTEntry) + offsetof(TTEntry, key16);
+          int g = i * sizeof(TTEntry) + offsetof(TTEntry, genBound8);
+          int d = i * sizeof(TTEntry) + offsetof(TTEntry, depth8);
+          m.keys |= 1u << k;
+          m.gen[g / 16][2 * i] = int8_t(g % 16);
+          m.depth[d / 16][2 * i + 1] = int8_t(d % 16);
+      }
+      return m;
+  }();
+
+  const __m128i lo = _mm_load_si128(reinterpret_cast<const __m128i*>(tte));
+  const __m128i hi = _mm_load_si128(reinterpret_cast<const __m128i*>(tte) + 1);
+  const __m128i k = _mm_set1_epi16(int16_t(key16)), zero = _mm_setzero_si128();
+
+  // The first entry which is empty or has our key, as in the scalar loop
+  uint32_t matches =  uint32_t(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi16(lo, k), _mm_cmpeq_epi16(lo, zero))))
+                    | uint32_t(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi16(hi, k), _mm_cmpeq_epi16(hi, zero)))) << 16;
+
+  if ((matches &= masks.keys))
+  {
+      TTEntry* const e = &tte[lsb(matches) / sizeof(TTEntry)];
+
+      if ((e->genBound8 & 0xFC) != generation8 && e->key16)
+          e->genBound8 = uint8_t(generation8 | e->bound()); // Refresh
+
+      return found = (bool)e->key16, e;
+  }
+
+  // The replace values as in the scalar loop below, in 16 bit lanes. The depth
+  // is sign extended by the arithmetic shift from the high bytes.
+  auto gather = [&](const int8_t (&control)[2][16]) {
+      return _mm_or_si128(_mm_shuffle_epi8(lo, _mm_load_si128(reinterpret_cast<const __m128i*>(control[0]))),
+                          _mm_shuffle_epi8(hi, _mm_load_si128(reinterpret_cast<const __m128i*>(control[1]))));
+  };
+
+  const __m128i depth = _mm_srai_epi16(gather(masks.depth), 8);
+  const __m128i age = _mm_and_si128(_mm_sub_epi16(_mm_set1_epi16(int16_t(259 + generation8)), gather(masks.gen)),
+                                    _mm_set1_epi16(0xFC));
+  __m128i value = _mm_sub_epi16(depth, _mm_add_epi16(age, age));
+
+  // The minimum comes first on ties, as in the scalar loop. It is unsigned, so
+  // the sign bits are flipped and the lanes of no entry are set to the maximum.
+  value = _mm_or_si128(_mm_xor_si128(value, _mm_set1_epi16(-0x8000)),
+                       _mm_load_si128(reinterpret_cast<const __m128i*>(masks.unused)));
+
+  return found = false, &tte[_mm_extract_epi16(_mm_minpos_epu16(value), 1)];
+
+#else
+
   for (int i = 0; i < ClusterSize; ++i)
       if (!tte[i].key16 || tte[i].key16 == key16)
       {
@@ -98,11 +248,14 @@ TTEntry* TranspositionTable::probe(const Key key, bool& found) const {
           replace = &tte[i];
 
   return found = false, replace;
+
+#endif
 }
 
 
 /// TranspositionTable::hashfull() returns an approximation of the hashtable
 /// occupation during a search. The hash is x permill full, as per UCI protocol.
+/// Only the entries of the current search are counted, never the empty ones.
 
 int TranspositionTable::hashfull() const {
 
@@ -111,7 +264,7 @@ int TranspositionTable::hashfull() const {
   {
       const TTEntry* tte = &table[i].entry[0];
       for (int j = 0; j < ClusterSize; j++)
-          if ((tte[j].genBound8 & 0xFC) == generation8)
+          if (tte[j].key16 && (tte[j].genBound8 & 0xFC) == generation8)
               cnt++;
   }
   return cnt;
@@ -24,6 +24,8 @@
 #include "misc.h"
 #include "types.h"
 
+namespace Search { struct LimitsType; }
+
 /// TTEntry struct is the 10 bytes transposition table entry, defined as below:
 ///
 /// key        16 bit
@@ -41,6 +43,7 @@ struct TTEntry {
   Value eval()  const { return (Value)eval16; }
   Depth depth() const { return (Depth)(depth8 * int(ONE_PLY)); }
   Bound bound() const { return (Bound)(genBound8 & 0x3); }
+  bool current(uint8_t g) const { return key16 && (genBound8 & 0xFC) == g; }
 
   void save(Key k, Value v, Bound b, Depth d, Move m, Value ev, uint8_t g) {
 
@@ -96,12 +99,15 @@ class TranspositionTable {
   static_assert(CacheLineSize % sizeof(Cluster) == 0, "Cluster size incorrect");
 
 public:
+  static constexpr int MaxHashMB = Is64Bit ? 131072 : 2048; // At most 2^32 clusters
+
  ~TranspositionTable() { free(mem); }
   void new_search() { generation8 += 4; } // Lower 2 bits are used by Bound
   uint8_t generation() const { return generation8; }
   TTEntry* probe(const Key key, bool& found) const;
   int hashfull() const;
-  void resize(size_t mbSize);
+  void resize(size_t mbSize, bool clearTable = true);
+  void auto_size(const Search::LimitsType& limits, Color us, size_t threads);
   void clear();
 
   // The 32 lowest order bits of the key are used to get the index of the cluster
@@ -114,6 +120,7 @@ private:
   Cluster* table;
   void* mem;
   uint8_t generation8; // Size must be not bigger than TTEntry::genBound8
+  int autoScale = 1; // Correction of the size estimate of auto_size()
 };
 
 extern TranspositionTable TT;
@@ -19,14 +19,19 @@
 */
 
 #include <cassert>
+#include <iomanip>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include "evaluate.h"
+#include "mate.h"
 #include "movegen.h"
 #include "position.h"
+#include "resultcache.h"
 #include "search.h"
+#include "searchtrace.h"
 #include "thread.h"
 #include "tt.h"
 #include "timeman.h"
@@ -118,12 +123,9 @@ namespace {
   void go(Position& pos, istringstream& is, StateListPtr& states) {
 
     Search::LimitsType limits;
-	Search::clear();
     string token;
     bool ponderMode = false;
 
-    limits.startTime = now(); // As early as possible!
-
     while (is >> token)
         if (token == "searchmoves")
             while (is >> token)
@@ -142,10 +144,247 @@ namespace {
         else if (token == "infinite")  limits.infinite = 1;
         else if (token == "ponder")    ponderMode = true;
 
+    if (!ponderMode && ResultCache::probe(pos, limits))
+        return;
+
+    // Before the table is cleared, so that it still holds the previous search
+    if (Options["Auto Hash"])
+    {
+        Threads.main()->wait_for_search_finished();
+        TT.auto_size(limits, pos.side_to_move(), Threads.size());
+    }
+
+    Search::clear();
+    limits.startTime = now(); // As early as possible!
+
     Threads.start_thinking(pos, states, limits, ponderMode);
   }
 
 
+  // eval_walk() visits every node of the legal move tree up to the given depth
+  // and runs the NNUE evaluation on each of them. Parents are evaluated before
+  // their children, as in a search, so this measures the incremental
+  // accumulator updates. Returns the number of evaluations done.
+
+  uint64_t eval_walk(Position& pos, int depth) {
+
+    StateInfo st;
+    uint64_t cnt = 1;
+
+    Eval::NNUE::evaluate(pos);
+
+    if (depth > 0)
+        for (const auto& m : MoveList<LEGAL>(pos))
+        {
+            pos.do_move(m, st);
+            cnt += eval_walk(pos, depth - 1);
+            pos.undo_move(m);
+        }
+
+    return cnt;
+  }
+
+
+  // capture_walk() checks Position::do_capture() and undo_capture() against
+  // do_move() and undo_move() at every node of the legal move tree up to the
+  // given depth. Both must give the same position and state, and undoing must
+  // restore the original position. Returns the number of moves checked.
+
+  uint64_t capture_walk(Position& pos, int depth, uint64_t& failures) {
+
+    StateInfo st, expected;
+    uint64_t cnt = 0;
+
+    auto same = [](const StateInfo& a, const StateInfo& b) {
+        return   a.key == b.key && a.pawnKey == b.pawnKey && a.materialKey == b.materialKey
+              && a.nonPawnMaterial[WHITE] == b.nonPawnMaterial[WHITE]
+              && a.nonPawnMaterial[BLACK] == b.nonPawnMaterial[BLACK]
+              && a.castlingRights == b.castlingRights && a.rule50 == b.rule50
+              && a.pliesFromNull == b.pliesFromNull && a.psq == b.psq && a.epSquare == b.epSquare
+              && a.checkersBB == b.checkersBB && a.capturedPiece == b.capturedPiece
+              && a.blockersForKing[WHITE] == b.blockersForKing[WHITE]
+              && a.blockersForKing[BLACK] == b.blockersForKing[BLACK]
+              && a.pinnersForKing[WHITE] == b.pinnersForKing[WHITE]
+              && a.pinnersForKing[BLACK] == b.pinnersForKing[BLACK]
+              && std::equal(a.checkSquares, a.checkSquares + PIECE_TYPE_NB, b.checkSquares)
+              && a.dirtyPiece.dirty_num == b.dirtyPiece.dirty_num
+              && std::equal(a.dirtyPiece.piece, a.dirtyPiece.piece + a.dirtyPiece.dirty_num, b.dirtyPiece.piece)
+              && std::equal(a.dirtyPiece.from, a.dirtyPiece.from + a.dirtyPiece.dirty_num, b.dirtyPiece.from)
+              && std::equal(a.dirtyPiece.to, a.dirtyPiece.to + a.dirtyPiece.dirty_num, b.dirtyPiece.to);
+    };
+
+    for (const auto& m : MoveList<LEGAL>(pos))
+    {
+        if (type_of(m) != ENPASSANT && pos.capture_or_promotion(m))
+        {
+            const string fen = pos.fen();
+            const Key key = pos.key();
+            const bool givesCheck = pos.gives_check(m);
+
+            pos.do_move(m, st, givesCheck);
+            pos.check_info();
+            expected = st;
+            const string expectedFen = pos.fen();
+            pos.undo_move(m);
+
+            pos.do_capture(m, st, givesCheck);
+            pos.check_info();
+            failures += !same(st, expected) || pos.fen() != expectedFen;
+            pos.undo_capture(m);
+            failures += pos.fen() != fen || pos.key() != key;
+            ++cnt;
+        }
+
+        if (depth > 1)
+        {
+            pos.do_move(m, st);
+            cnt += capture_walk(pos, depth - 1, failures);
+            pos.undo_move(m);
+        }
+    }
+
+    return cnt;
+  }
+
+
+  // ttbench() measures TT::probe() alone. The table is filled with random keys,
+  // then probed with a hit-heavy stream of stored keys and a miss-heavy stream
+  // of new keys, each followed by a save as in the search. The table is
+  // resized to the "Hash" option and cleared at the end.
+
+  void ttbench(istringstream& is) {
+
+    size_t mb = 256, probes = 10000000;
+    is >> mb >> probes;
+
+    Threads.main()->wait_for_search_finished();
+    TT.resize(mb);
+    TT.clear();
+    TT.new_search();
+
+    // At most a quarter of the entries are probed by the hit-heavy stream
+    size_t entries = mb * 1024 * 1024 / sizeof(TTEntry), n = 1;
+    while (n < (1 << 20) && n * 8 <= entries)
+        n *= 2;
+
+    PRNG rng(1070372);
+    std::vector<Key> keys(n);
+    bool found;
+
+    for (size_t i = 0; i < entries; ++i)
+    {
+        Key k = rng.rand<Key>();
+        TT.probe(k, found)->save(k, VALUE_ZERO, BOUND_UPPER, Depth(int(k & 15)), MOVE_NONE, VALUE_ZERO, TT.generation());
+    }
+
+    // Deeper than the other entries, so that they stay in the table
+    for (Key& k : keys)
+    {
+        k = rng.rand<Key>();
+        TT.probe(k, found)->save(k, VALUE_ZERO, BOUND_EXACT, Depth(60), MOVE_NONE, VALUE_ZERO, TT.generation());
+    }
+
+    for (bool hits : { true, false })
+    {
+        uint64_t hitCount = 0;
+        TimePoint elapsed = now();
+
+        for (size_t i = 0; i < probes; ++i)
+        {
+            Key k = hits ? keys[rng.rand<size_t>() & (keys.size() - 1)] : rng.rand<Key>();
+            TTEntry* tte = TT.probe(k, found);
+            hitCount += found;
+            tte->save(k, VALUE_ZERO, BOUND_LOWER, Depth(int(k & 15)), MOVE_NONE, VALUE_ZERO, TT.generation());
+        }
+
+        elapsed = now() - elapsed + 1;
+
+        sync_cout << (hits ? "Hit-heavy " : "Miss-heavy")
+                  << ": " << fixed << setprecision(2) << 1e6 * elapsed / probes << " ns/probe, "
+                  << 100.0 * hitCount / probes << "% hits" << sync_endl;
+    }
+
+    TT.resize(Options["Hash"]);
+    TT.clear();
+  }
+
+
+  // print_counters() writes the hardware counters of a bench run per node, on
+  // one line for a single position or one line per counter for the total.
+
+  void print_counters(const PerfCounters::Sample& s, uint64_t nodes, bool total) {
+
+    using namespace PerfCounters;
+
+    const char* names[] = { "Cycles/node", "Instructions/node", "IPC", "L1d misses/node",
+                            "LLC misses/node", "dTLB misses/node", "Branch misses/node" };
+    double n = double(std::max(nodes, uint64_t(1)));
+    string sep;
+
+    cerr << fixed << setprecision(2);
+
+    for (int i = 0; i <= EVENT_NB; ++i)
+    {
+        // IPC comes after the instructions, the other counters are shifted by one
+        int e = i < 2 ? i : i - 1;
+        bool valid = i == 2 ? s.valid[CYCLES] && s.valid[INSTRUCTIONS] && s.count[CYCLES] > 0
+                            : s.valid[e];
+        double v = i == 2 ? s.count[INSTRUCTIONS] / s.count[CYCLES] : s.count[e] / n;
+
+        if (total)
+            cerr << "\n" << left << setw(19) << names[i] << right << ": ";
+        else
+            cerr << sep << names[i] << " ";
+
+        if (valid)
+            cerr << v;
+        else
+            cerr << "n/a";
+
+        sep = ", ";
+    }
+
+    cerr << defaultfloat << setprecision(6) << endl;
+  }
+
+
+  // BenchConfig holds the results of bench for one TT size and thread count.
+  // The time is the start time until the configuration is complete.
+
+  struct BenchConfig {
+    double rate(uint64_t n) const { return probes ? double(n) / probes : 0.0; }
+
+    int hash, threads;
+    TimePoint time;
+    uint64_t positions, nodes, probes, hits, collisions, hashfull;
+  };
+
+
+  // print_config() writes the results of a bench configuration, as a line of
+  // text or as a row of the final table.
+
+  void print_config(const BenchConfig& c, bool row) {
+
+    cerr << fixed << setprecision(2);
+
+    if (row)
+        cerr << "\n" << setw(7) << c.hash << setw(9) << c.threads << setw(11) << c.time
+             << setw(14) << c.nodes << setw(14) << 1000 * c.nodes / c.time
+             << setw(8) << 100 * c.rate(c.hits) << "%"
+             << setw(11) << 100 * c.rate(c.collisions) << "%"
+             << setw(10) << c.hashfull / c.positions;
+    else
+        cerr << "\nHash " << c.hash << " MB, threads " << c.threads
+             << ": time (ms) " << c.time << ", nodes " << c.nodes
+             << ", nodes/second " << 1000 * c.nodes / c.time
+             << ", TT hits " << 100 * c.rate(c.hits) << "%"
+             << ", collisions " << 100 * c.rate(c.collisions) << "%"
+             << ", hashfull " << c.hashfull / c.positions << endl;
+
+    cerr << defaultfloat << setprecision(6);
+  }
+
+
   // bench() is called when engine receives the "bench" command. Firstly
   // a list of UCI commands is setup according to bench parameters, then
   // it is run one by one printing a summary at the end.
@@ -153,12 +392,39 @@ namespace {
   void bench(Position& pos, istream& args, StateListPtr& states) {
 
     string token;
-    uint64_t num, nodes = 0, cnt = 1;
+    uint64_t num, nodes = 0, cheapCuts = 0, fullEvals = 0, refreshes = 0, reuses = 0, batched = 0, batchHits = 0, cnt = 1;
 
     vector<string> list = setup_bench(pos, args);
     num = count_if(list.begin(), list.end(), [](string s) { return s.find("go ") == 0; });
 
+    bool evalBench = any_of(list.begin(), list.end(), [](string s) { return s.find("go eval ") == 0; });
+    if (evalBench && !Eval::useNNUE)
+    {
+        cerr << "The eval benchmark requires \"Use NNUE\" to be enabled" << endl;
+        return;
+    }
+
+    // With several TT sizes or thread counts report each combination
+    bool sweep = count_if(list.begin(), list.end(), [](string s) {
+                              return s.find("setoption name Threads ") == 0; }) > 1;
+    bool counters = count(list.begin(), list.end(), "counters");
+    bool json = count(list.begin(), list.end(), "json");
+    Threads.ttStats = sweep || json;
+    PerfCounters::Sample totalCounters;
     TimePoint elapsed = now();
+    vector<BenchConfig> configs;
+    BenchConfig config = {};
+
+    auto end_config = [&]() {
+        if (config.positions)
+        {
+            config.time = now() - config.time + 1;
+            configs.push_back(config);
+            if (sweep)
+                print_config(config, false);
+        }
+        config = {};
+    };
 
     for (const auto& cmd : list)
     {
@@ -168,15 +434,71 @@ namespace {
         if (token == "go")
         {
             cerr << "\nPosition: " << cnt++ << '/' << num << endl;
-            go(pos, is, states);
-            Threads.main()->wait_for_search_finished();
-            nodes += Threads.nodes_searched();
+
+            if (!config.positions++)
+            {
+                config.hash = Options["Hash"];
+                config.threads = Options["Threads"];
+                config.time = now();
+            }
+
+            if (counters && !PerfCounters::start())
+            {
+                cerr << "Hardware performance counters not available" << endl;
+                counters = false;
+            }
+
+            uint64_t positionNodes;
+
+            if (evalBench)
+            {
+                int depth;
+                is >> token >> depth;
+                pos.this_thread()->nnueRefreshes = 0;
+                positionNodes = eval_walk(pos, depth);
+                refreshes += pos.this_thread()->nnueRefreshes;
+            }
+            else
+            {
+                go(pos, is, states);
+                Threads.main()->wait_for_search_finished();
+                sync_flush(); // Keep the search output before our own on stderr
+                positionNodes = Threads.nodes_searched();
+                cheapCuts += Threads.cheap_eval_cuts();
+                fullEvals += Threads.full_evals();
+                refreshes += Threads.nnue_refreshes();
+                reuses += Threads.nnue_reuses();
+                batched += Threads.nnue_batched();
+                batchHits += Threads.nnue_batch_hits();
+                config.probes += Threads.tt_probes();
+                config.hits += Threads.tt_hits();
+                config.collisions += Threads.tt_collisions();
+                config.hashfull += TT.hashfull();
+            }
+
+            nodes += positionNodes;
+            config.nodes += positionNodes;
+
+            if (counters)
+            {
+                PerfCounters::Sample s = PerfCounters::stop();
+                print_counters(s, positionNodes, false);
+                totalCounters += s;
+            }
+        }
+        else if (token == "setoption")
+        {
+            if (   cmd.find("name Threads ") != string::npos
+                || cmd.find("name Hash ") != string::npos)
+                end_config();
+            setoption(is);
         }
-        else if (token == "setoption")  setoption(is);
         else if (token == "position")   position(pos, is, states);
-        else if (token == "ucinewgame") Search::clear();
+        else if (token == "ucinewgame") Search::clear(), Mate::clear();
     }
 
+    end_config();
+    Threads.ttStats = false;
     elapsed = now() - elapsed + 1; // Ensure positivity to avoid a 'divide by zero'
 
     dbg_print(); // Just before exiting
@@ -185,6 +507,54 @@ namespace {
          << "\nTotal time (ms) : " << elapsed
          << "\nNodes searched  : " << nodes
          << "\nNodes/second    : " << 1000 * nodes / elapsed << endl;
+
+    if (cheapCuts + fullEvals)
+        cerr << "Cheap bound cuts: " << cheapCuts
+             << "\nFull evals      : " << fullEvals << endl;
+
+    if (Eval::useNNUE)
+        cerr << "NNUE refreshes  : " << refreshes
+             << "\nNull move reuses: " << reuses << endl;
+
+    if (batched)
+        cerr << "Batched evals   : " << batched
+             << "\nBatch evals used: " << batchHits << endl;
+
+    if (evalBench)
+        cerr << "Nanosecs/eval   : " << 1000000 * elapsed / std::max(nodes, uint64_t(1)) << endl;
+
+    if (counters)
+        print_counters(totalCounters, nodes, true);
+
+    if (sweep)
+    {
+        cerr << "\n   Hash  Threads  Time (ms)         Nodes  Nodes/second  TT hits  Collisions  Hashfull";
+        for (const BenchConfig& c : configs)
+            print_config(c, true);
+        cerr << endl;
+    }
+
+    if (json)
+    {
+        stringstream ss;
+        string sep;
+
+        ss << fixed << setprecision(4) << "{\"configs\":[";
+        for (const BenchConfig& c : configs)
+        {
+            ss << sep << "{\"hash\":" << c.hash << ",\"threads\":" << c.threads
+               << ",\"positions\":" << c.positions << ",\"time_ms\":" << c.time
+               << ",\"nodes\":" << c.nodes << ",\"nps\":" << 1000 * c.nodes / c.time
+               << ",\"tt_hit_rate\":" << c.rate(c.hits)
+               << ",\"collision_rate\":" << c.rate(c.collisions)
+               << ",\"hashfull\":" << c.hashfull / c.positions << "}";
+            sep = ",";
+        }
+        ss << "]}";
+
+        sync_cout << ss.str() << sync_endl;
+        sync_flush();
+    }
   }
 
 } // namespace
@@ -238,7 +608,7 @@ void UCI::loop(int argc, char* argv[]) {
       else if (token == "setoption")  setoption(is);
       else if (token == "go")         go(pos, is, states);
       else if (token == "position")   position(pos, is, states);
-      else if (token == "ucinewgame") Search::clear();
+      else if (token == "ucinewgame") Search::clear(), Mate::clear();
       else if (token == "isready")    sync_cout << "readyok" << sync_endl;
 
       // Additional custom non-UCI commands, mainly for debugging
@@ -246,6 +616,17 @@ void UCI::loop(int argc, char* argv[]) {
       else if (token == "bench") bench(pos, is, states);
       else if (token == "d")     sync_cout << pos << sync_endl;
       else if (token == "eval")  trace_eval(pos);
+      else if (token == "ttbench") ttbench(is);
+      else if (token == "qperft")
+      {
+          int depth = 4;
+          uint64_t failures = 0;
+          is >> depth;
+          uint64_t cnt = capture_walk(pos, depth, failures);
+          sync_cout << "Captures checked: " << cnt << ", mismatches: " << failures << sync_endl;
+      }
+      else if (token == "tracestat")
+          SearchTrace::summary((is >> token) ? token : "search.trace");
       else
           sync_cout << "Unknown command: " << cmd << sync_endl;
 
@@ -22,7 +22,9 @@
 #include <cassert>
 #include <ostream>
 
+#include "experience.h"
 #include "misc.h"
+#include "resultcache.h"
 #include "search.h"
 #include "thread.h"
 #include "tt.h"
@@ -37,8 +39,11 @@ namespace UCI {
 /// 'On change' actions, triggered by an option's value change
 void on_hash_size(const Option& o) { TT.resize(o); }
 void on_threads(const Option& o) { Threads.set(o); }
-void on_use_NNUE(const Option&) { Eval::NNUE::init(); }
-void on_eval_file(const Option&) { Eval::NNUE::init(); }
+void on_use_NNUE(const Option&) { Eval::NNUE::init(); ResultCache::clear(); }
+void on_eval_file(const Option&) { Eval::NNUE::init(); ResultCache::clear(); }
+void on_numa_replication(const Option& o) { Eval::NNUE::replicate(o); Threads.set(0); Threads.set(Options["Threads"]); }
+void on_experience_file(const Option& o) { Experience::init(o); }
+void on_result_cache(const Option& o) { ResultCache::resize(int(o)); }
 
 
 /// Our case insensitive less() function as required by UCI protocol
@@ -53,16 +58,24 @@ bool CaseInsensitiveLess::operator() (const string& s1, const string& s2) const
 
 void init(OptionsMap& o) {
 
-  // at most 2^32 clusters.
-  const int MaxHashMB = Is64Bit ? 131072 : 2048;
-
   o["Threads"]               << Option(1, 1, 512, on_threads);
-  o["Hash"]                  << Option(16, 1, MaxHashMB, on_hash_size);
+  o["Hash"]                  << Option(16, 1, TranspositionTable::MaxHashMB, on_hash_size);
+  o["Auto Hash"]             << Option(false);
   o["MultiPV"]               << Option(1, 1, 500);
   o["Move Overhead"]         << Option(30, 0, 5000);
   o["UCI_Chess960"]          << Option(false);
   o["Use NNUE"] << Option(true, on_use_NNUE);
   o["EvalFile"] << Option(EvalFileDefaultName, on_eval_file);
+  o["NNUE Cheap Bound"] << Option(false);
+  o["NNUE Batch Eval"] << Option(false);
+  o["NUMA Replication"] << Option(false, on_numa_replication);
+  o["Mate Solver"] << Option(true);
+  o["Experience File"] << Option("<empty>", on_experience_file);
+  o["Experience Plies"] << Option(16, 0, 100);
+  o["Experience Depth"] << Option(20, 1, 100);
+  o["Analysis Cache"] << Option(0, 0, 1000000, on_result_cache);
+  o["Analysis Cache Keep Deepest"] << Option(false);
+  o["Shared Time Management"] << Option(false);
 }
 
 